@@ -0,0 +1,87 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#include "../header/builder.h"
+#include "../header/gates.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+
+/* Time to build a random permutation of 2^n elements with SpBuilder and
+ * with Gates::make_fgate, for 16, 18 and 20 qubits. The time per element
+ * should not grow with n. */
+
+using namespace arma;
+
+/*********************************************************/
+template <class F>
+static double seconds(F f) {
+  auto begin = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> time = std::chrono::steady_clock::now()-begin;
+  return time.count();
+}
+
+/*********************************************************/
+int main() {
+  Py_Initialize();
+
+  printf("%6s %12s %12s %14s %14s\n", "qubits", "builder (s)", "fgate (s)",
+         "builder (ns)", "fgate (ns)");
+
+  for (size_t n : {16, 18, 20}) {
+    size_t dim = 1ul << n;
+
+    vec_size_t perm(dim);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), std::mt19937_64{42});
+
+    double builder = seconds([&]() {
+      SpBuilder m{dim, dim, dim};
+      for (size_t j = 0; j < dim; j++)
+        m.set(perm[j], j, 1);
+      m.build();
+    });
+
+    /* the same permutation, as the __getitem__ of a Python list */
+    PyObject* list = PyList_New(dim);
+    for (size_t j = 0; j < dim; j++)
+      PyList_SET_ITEM(list, j, PyLong_FromSize_t(perm[j]));
+    PyObject* func = PyObject_GetAttrString(list, "__getitem__");
+
+    Gates gates;
+    double fgate = seconds([&]() { gates.make_fgate("P", func, n); });
+
+    Py_DECREF(func);
+    Py_DECREF(list);
+
+    printf("%6zu %12.3f %12.3f %14.1f %14.1f\n", n, builder, fgate,
+           1e9*builder/dim, 1e9*fgate/dim);
+  }
+
+  Py_Finalize();
+  return 0;
+}
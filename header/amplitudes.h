@@ -0,0 +1,59 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */     
+
+#pragma once
+#include "using.h"
+#include <armadillo>
+
+//! 64-byte aligned buffer of complex amplitudes
+/*!
+ * Dense storage used by QSystem when the state is mostly filled. The buffer
+ * is laid out like an Armadillo matrix (column-major) and can be viewed as one
+ * without copying. A larger capacity can be reserved up front so the buffer
+ * can later grow in place with Amplitudes::reshape.
+ */
+class Amplitudes {
+  public:
+    Amplitudes();
+    Amplitudes(size_t n_rows, size_t n_cols, size_t capacity=0);
+    Amplitudes(Amplitudes &&other);
+    Amplitudes(const Amplitudes&) = delete;
+    ~Amplitudes();
+
+    Amplitudes& operator=(Amplitudes &&other);
+    Amplitudes& operator=(const Amplitudes&) = delete;
+
+    complex*     memptr();
+    arma::cx_mat mat();
+    size_t       capacity();
+    void         reshape(size_t n_rows, size_t n_cols);
+
+    size_t n_rows;
+    size_t n_cols;
+    size_t n_elem;
+
+  private:
+    size_t   n_alloc;
+    complex *mem;
+};
@@ -0,0 +1,66 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#pragma once
+#include "using.h"
+#include <armadillo>
+
+//! Class that builds a sparse matrix from its non-zero elements
+/*!
+ * Setting the elements of an `arma::sp_cx_mat` one by one can move all the
+ * elements stored after each of them, what makes the construction quadratic
+ * in the number of non-zero elements. This class collects the elements and
+ * builds the CSC arrays of the matrix at once, in linear time.
+ */
+class SpBuilder {
+  public:
+    //! Constructor
+    /*!
+     * \param n_rows number of rows of the matrix.
+     * \param n_cols number of columns of the matrix.
+     * \param nnz expected number of non-zero elements.
+     */
+    SpBuilder(size_t n_rows, size_t n_cols, size_t nnz=0);
+
+    //! Set an element of the matrix
+    /*!
+     * Like `m(row, col) = value`, if the same element is set more than once
+     * the last value is kept.
+     */
+    void set(size_t row, size_t col, complex value);
+
+    //! Build the sparse matrix
+    /*!
+     * \param add_values if true, the values of an element set more than once
+     * are summed, otherwise the last one is kept.
+     */
+    arma::sp_cx_mat build(bool add_values=false);
+
+  private:
+    size_t      n_rows;
+    size_t      n_cols;
+    vec_size_t  rows;
+    vec_size_t  cols;
+    vec_complex values;
+};
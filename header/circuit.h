@@ -0,0 +1,264 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#pragma once
+#include "gates.h"
+#include <algorithm>
+
+//! Class that records a quantum circuit
+/*!
+ * The operations are validated when recorded and stored with the qubits
+ * already arranged as the QSystem class applies them, so the circuit can be
+ * executed many times by QSystem::run without validating it again. The
+ * rotations can take their angles from a list of parameters given to
+ * QSystem::run. The noise channels are applied exactly to a density matrix
+ * and as one random Kraus operator to a state vector, what lets the same
+ * circuit be run as quantum trajectories.
+ */
+class Circuit {
+  struct Op {
+    enum Kind {GATE_1, GATE_N,
+               CNOT, CPHASE,
+               CONTROLLED, QFT,
+               SWAP, ROT,
+               PHASE, MEASURE,
+               NOISE} kind;
+
+    size_t      qbit;
+    size_t      size;
+    std::string gate;
+    size_t      target;
+    vec_size_t  targets;
+    vec_size_t  control;
+    complex     phase;
+    char        axis;
+    size_t      param;
+    double      scale;
+    bool        inver;
+
+    std::vector<arma::sp_cx_mat> kraus;
+    vec_float       p;
+    arma::sp_cx_mat super;
+  };
+
+  public:
+    //! Constructor
+    /*!
+     * \param nqbits number of qubits of the circuit, that must be the size
+     * of the QSystem that runs it.
+     * \param gates instance of class Gates that holds the gates used in the
+     * method Circuit::evol.
+     */
+    Circuit(size_t nqbits, Gates& gates);
+
+    //! Record a quantum gate
+    /*!
+     * \sa QSystem::evol
+     */
+    void evol(std::string gate,
+                   size_t qbit, 
+                   size_t count=1,
+                     bool inver=false);
+
+    //! Record a quantum gate in a list of qubits
+    /*!
+     * \sa QSystem::evol
+     */
+    void evol(std::string gate,
+               vec_size_t qbits, 
+                     bool inver=false);
+
+    //! Record a controlled not 
+    /*!
+     * \sa QSystem::cnot
+     */
+    void cnot(size_t target, vec_size_t control);
+
+    //! Record a controlled phase
+    /*!
+     * \sa QSystem::cphase Circuit::phase
+     */
+    void cphase(complex phase, size_t target, vec_size_t control);
+
+    //! Record a controlled quantum gate
+    /*!
+     * \sa QSystem::controlled
+     */
+    void controlled(std::string gate,
+                         size_t target,
+                     vec_size_t control,
+                           bool inver=false);
+
+    //! Record a controlled quantum gate in a list of qubits
+    /*!
+     * \sa QSystem::controlled
+     */
+    void controlled(std::string gate,
+                     vec_size_t targets,
+                     vec_size_t control,
+                           bool inver=false);
+
+    //! Record a quantum Fourier transformation
+    /*!
+     * \sa QSystem::qft
+     */
+    void qft(size_t qbegin, size_t qend, bool inver=false);
+
+    //! Record a swap
+    /*!
+     * \sa QSystem::swap
+     */
+    void swap(size_t qbit_a, size_t qbit_b);
+
+    //! Record a parameterized rotation
+    /*!
+     * Apply \f$R_\text{axis}(\theta) = e^{-i\theta\sigma/2}\f$, whare
+     * \f$\sigma\f$ is the Pauli matrix of `axis` and \f$\theta\f$ =
+     * `scale*params[param]`, with `params` given to QSystem::run.
+     *
+     * \param axis ```'X'```, ```'Y'``` or ```'Z'```.
+     * \param qbit qubit affected by the rotation.
+     * \param param index of the angle in the parameter list.
+     * \param scale factor multiplied by the angle.
+     * \sa Circuit::phase QSystem::run
+     */
+    void rot(char axis, size_t qbit, size_t param, double scale=1);
+
+    //! Record a parameterized controlled phase
+    /*!
+     * Apply \f$\begin{bmatrix}1&0\\0&e^{i\theta}\end{bmatrix}\f$, whare
+     * \f$\theta\f$ = `scale*params[param]`, in the `target` qubit if all the
+     * `control` qubits, that can be none, are in the state
+     * \f$\left|1\right>\f$.
+     *
+     * \param target target qubit.
+     * \param control list of control qubits.
+     * \param param index of the angle in the parameter list.
+     * \param scale factor multiplied by the angle.
+     * \sa Circuit::rot QSystem::run
+     */
+    void phase(size_t target,
+           vec_size_t control,
+               size_t param,
+               double scale=1);
+
+    //! Record a measurement
+    /*!
+     * \sa QSystem::measure
+     */
+    void measure(size_t qbit, size_t count=1);
+
+    //! Record a bit, phase or bit-phase flip error
+    /*!
+     * \sa QSystem::flip
+     */
+    void flip(char gate, size_t qbit, double p);
+
+    //! Record an amplitude damping channel error
+    /*!
+     * \sa QSystem::amp_damping
+     */
+    void amp_damping(size_t qbit, double p);
+
+    //! Record a depolarization channel error
+    /*!
+     * \sa QSystem::dpl_channel
+     */
+    void dpl_channel(size_t qbit, double p);
+
+    //! Record a sum operator
+    /*!
+     * \sa QSystem::sum
+     */
+    void sum(size_t qbit, vec_str kraus, vec_float p);
+
+    //! Record a quantum channel
+    /*!
+     * \sa QSystem::channel Gates::make_channel
+     */
+    void channel(std::string name, size_t qbit);
+
+    //! Get the number of qubits
+    /*!
+     * \return Number of qubits of the circuit.
+     */
+    size_t size();
+
+    //! Get the number of parameters
+    /*!
+     * \return Minimum size of the parameter list given to QSystem::run.
+     */
+    size_t params();
+
+  private:
+    friend class QSystem;
+
+    void            push(Op::Kind kind, size_t qbit, size_t size_n);
+    void            cut(size_t target, vec_size_t control);
+    size_t          gate_size(std::string gate);
+    void            noise(size_t qbit,
+         std::vector<arma::sp_cx_mat> kraus,
+                       vec_float p,
+                 arma::sp_cx_mat super);
+
+    std::vector<Op> ops;
+    size_t          nqbits;
+    size_t          nparams;
+    Gates&          gates;
+
+    inline void     valid_qbit(std::string name, size_t qbit);
+    inline void     valid_list(std::string name, vec_size_t &qbits);
+    inline void     valid_p(double p);
+};
+
+/******************************************************/
+inline void Circuit::valid_qbit(std::string name, size_t qbit) {
+  if (qbit >= nqbits) {
+      sstr err;
+      err << "\'" << name << "\' argument should be in the range of 0 to "
+          << (nqbits-1);
+      throw std::invalid_argument{err.str()};
+  }
+}
+
+/******************************************************/
+inline void Circuit::valid_list(std::string name, vec_size_t &qbits) {
+  for (auto& i : qbits) {
+    valid_qbit(name, i);
+    if (std::count(qbits.begin(), qbits.end(), i) > 1) {
+      sstr err;
+      err << "Qubit " << i << " repeated in \'" << name << "\'";
+      throw std::invalid_argument{err.str()};
+    }
+  }
+}
+
+/******************************************************/
+inline void Circuit::valid_p(double p) {
+  if (p < 0 or p > 1) {
+    sstr err;
+    err << "\'p\' argument should be in the range of 0.0 to 1.0";
+    throw std::invalid_argument{err.str()};
+  }
+}
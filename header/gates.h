@@ -144,6 +144,24 @@ class Gates {
                          size_t size,
                       PyObject* iterator=Py_None);
 
+    //! Create a quantum channel from Kraus operators
+    /*!
+     * The channel \f$\mathcal{E}(\rho) = \sum_i p_i E_i\rho E_i^\dagger\f$
+     * is compiled once into a superoperator that acts only on the qubits of
+     * the channel, so applying it with QSystem::channel costs one pass over
+     * the density matrix.
+     *
+     * Each item of `kraus` is the name of a multiple qubits gate, like the
+     * ones created by Gates::make_mgate, or a string of one qubit gates,
+     * like in QSystem::sum. All the operators must have the same size.
+     *
+     * \param name of the new channel.
+     * \param kraus Kraus operators list.
+     * \param p probability list.
+     * \sa QSystem::channel QSystem::sum
+     */
+    void make_channel(std::string name, vec_str kraus, vec_float p);
+
     //! Get a string with information
     /*!
      *  This method is used in Python to cast a instance to `str`.
@@ -181,8 +199,135 @@ class Gates {
      */
     arma::sp_cx_mat& mget(std::string gate);
 
+    //! Return the superoperator of a quantum channel
+    /*!
+     * This method is used by the QSystem class.
+     *
+     * \param name of the channel.
+     * \return Sparse matrix of the superoperator over the column and row
+     * qubits of the density matrix.
+     * \sa Gates::make_channel
+     */
+    arma::sp_cx_mat& channel(std::string name);
+
+    //! Return the Kraus operators of a quantum channel
+    /*!
+     * This method is used by the QSystem class to apply the channel in a
+     * state vector, one operator at a time.
+     *
+     * \param name of the channel.
+     * \return Kraus operators list and probability list.
+     * \sa Gates::make_channel
+     */
+    std::pair<std::vector<arma::sp_cx_mat>, vec_float>& 
+    channel_kraus(std::string name);
+
+    //! Return a Kraus operator
+    /*!
+     * This method is used by the QSystem class.
+     *
+     * \param ops name of a multiple qubits gate or a string of one qubit
+     * gates.
+     * \return Sparse matrix of the operator.
+     * \sa Gates::make_channel
+     */
+    arma::sp_cx_mat kraus(std::string ops);
+
+    //! Build the superoperator of a list of Kraus operators
+    /*!
+     * This method is used by the QSystem class. The superoperator is 
+     * \f$p_\text{id}I + \sum_i p_i E_i^*\otimes E_i\f$, whare the first
+     * factor acts on the column qubits of the density matrix.
+     *
+     * \param kraus Kraus operators list.
+     * \param p probability list.
+     * \param p_id weight of the identity.
+     * \return Sparse matrix of the superoperator.
+     * \sa Gates::make_channel
+     */
+    static arma::sp_cx_mat superop(const std::vector<arma::sp_cx_mat> &kraus,
+                                                            vec_float p,
+                                                               double p_id=0);
+
+    //! Build the Kraus operators of the amplitude damping channel
+    /*!
+     * This method is used by the QSystem and Circuit classes.
+     *
+     * \param p probability of the qubit decaying to \f$\left|0\right>\f$.
+     * \return Kraus operators list, with probability 1 each.
+     * \sa QSystem::amp_damping
+     */
+    static std::vector<arma::sp_cx_mat> amp_damping(double p);
+
+    //! Check if a quantum gate of one qubit is diagonal
+    /*!
+     * This method is used by the QSystem class to apply diagonal gates as a
+     * phase multiplication.
+     *
+     * \param gate name of the gate.
+     * \return true if all non-zero elements are in the diagonal.
+     * \sa Gates::mdiagonal
+     */
+    bool diagonal(char gate);
+
+    //! Check if a quantum gate of multiple qubits is diagonal
+    /*!
+     * This method is used by the QSystem class to apply diagonal gates as a
+     * phase multiplication.
+     *
+     * \param gate name of the gate.
+     * \return true if all non-zero elements are in the diagonal.
+     * \sa Gates::diagonal
+     */
+    bool mdiagonal(std::string gate);
+
+    //! Get the basis permutation of a quantum gate of one qubit
+    /*!
+     * This method is used by the QSystem class to apply permutation gates
+     * by moving the amplitudes.
+     *
+     * \param gate name of the gate.
+     * \return list `perm` whare the gate takes \f$\left|j\right>\f$ to 
+     * \f$\left|\text{perm}[j]\right>\f$, or an empty list if the gate is
+     * not a permutation.
+     * \sa Gates::mpermutation
+     */
+    vec_size_t permutation(char gate);
+
+    //! Get the basis permutation of a quantum gate of multiple qubits
+    /*!
+     * This method is used by the QSystem class to apply permutation gates,
+     * like the ones created by Gates::make_fgate, by moving the amplitudes.
+     *
+     * \param gate name of the gate.
+     * \return list `perm` whare the gate takes \f$\left|j\right>\f$ to 
+     * \f$\left|\text{perm}[j]\right>\f$, or an empty list if the gate is
+     * not a permutation.
+     * \sa Gates::permutation
+     */
+    vec_size_t& mpermutation(std::string gate);
+
+    //! Get the control qubits of a quantum gate of multiple qubits
+    /*!
+     * This method is used by the QSystem class to apply controlled gates,
+     * like the ones created by Gates::make_cgate, only on the amplitudes
+     * whare all the control qubits are in the state \f$\left|1\right>\f$.
+     *
+     * \param gate name of the gate.
+     * \return mask with the bit `size-i-1` set if the gate acts as the
+     * identity whenever the qubit `i` is in the state \f$\left|0\right>\f$.
+     * \sa Gates::mpermutation
+     */
+    size_t mcontrol(std::string gate);
+
   private:
+  void insert(std::string name, arma::sp_cx_mat m);
+
   std::map<std::string, arma::sp_cx_mat> mmap;
+  std::map<std::string, vec_size_t> pmap;
+  std::map<std::string, size_t> cmap;
+  std::map<std::string, arma::sp_cx_mat> smap;
+  std::map<std::string, std::pair<std::vector<arma::sp_cx_mat>, vec_float>> kmap;
 
   std::map<char, arma::sp_cx_mat> map{
     {'I', arma::sp_cx_mat{arma::cx_mat{{{{1,0}, {0,0}},
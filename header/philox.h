@@ -0,0 +1,77 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#pragma once
+#include "using.h"
+#include <cstdint>
+
+//! Counter-based pseudorandom number generator
+/*!
+ * Philox4x32-10 (Salmon et al., 2011). The number of index `i` is a
+ * function of the key, the stream and `i` alone, so draws can be taken in
+ * any order or in parallel and give the same result. Each instance of
+ * QSystem owns one, so systems with the same seed give the same results
+ * whatever the number of threads or of other systems.
+ */
+class Philox {
+  public:
+    //! Constructor
+    /*!
+     * \param seed key of the generator.
+     * \param stream independent sequence of the key.
+     */
+    Philox(uint64_t seed=0, uint64_t stream=0);
+
+    //! Next number of the sequence, uniform in [0, 1)
+    double uniform();
+
+    //! Number of index `index` of the sequence, uniform in [0, 1)
+    /*!
+     * Does not advance the sequence, so it can be called from many threads
+     * at once.
+     */
+    double uniform(uint64_t index) const;
+
+    //! Generator of a new independent stream
+    /*!
+     * Advances the sequence by one. The returned generator can be used for
+     * a thread, a shot or a trajectory without changing this sequence.
+     */
+    Philox split();
+
+    //! Generator of the independent stream `index`
+    /*!
+     * Does not advance the sequence, the same index always gives the same
+     * stream.
+     */
+    Philox split(uint64_t index) const;
+
+  private:
+    uint64_t bits(uint64_t index) const;
+
+    uint64_t key;
+    uint64_t stream;
+    uint64_t count;
+};
@@ -0,0 +1,70 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */     
+
+#pragma once
+#include "using.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//! Pool of worker threads shared by all QSystem instances
+/*!
+ * A job is a number of independent blocks. The blocks are taken in any
+ * order by the calling thread and by up to `nthreads-1` workers, so the
+ * result of a job must not depend on which thread runs each block. If a
+ * block throws, no more blocks are handed out and the first exception is
+ * rethrown by ThreadPool::run once all threads have left the job.
+ */
+class ThreadPool {
+  public:
+    ThreadPool();
+    ~ThreadPool();
+
+    void run(size_t nthreads,
+             size_t nblocks,
+             const std::function<void(size_t)> &block);
+
+    static ThreadPool& global();
+
+  private:
+    void work(size_t id);
+    void take_blocks();
+
+    std::vector<std::thread>    workers;
+    std::mutex                  job_mutex;
+    std::mutex                  mutex;
+    std::condition_variable     start;
+    std::condition_variable     done;
+
+    const std::function<void(size_t)> *job;
+    size_t                      nblocks;
+    size_t                      next;
+    size_t                      nworkers;
+    size_t                      running;
+    size_t                      generation;
+    bool                        stop;
+    std::exception_ptr          error;
+};
@@ -24,7 +24,14 @@
 
 #pragma once
 #include "gates.h"
+#include "circuit.h"
+#include "amplitudes.h"
+#include "philox.h"
 #include <Python.h>
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <unordered_map>
 #include <variant>
 
 //! Quantum circuit simulator class.
@@ -38,12 +45,18 @@ class QSystem {
 
     enum Tag {GATE_1, GATE_N,
               CNOT, CPHASE,
-              SWAP, QFT} tag;
+              SWAP, QFT,
+              MATRIX, DIAG,
+              CONTROLLED} tag;
 
-    std::variant<char,
-                 std::string,
-                 cnot_pair,
-                 cph_tuple> data;
+    using op_data = std::variant<char,
+                                 std::string,
+                                 cnot_pair,
+                                 cph_tuple,
+                                 ctrl_tuple,
+                                 arma::sp_cx_mat,
+                                 std::vector<diag_term>>;
+    op_data data;
 
     size_t size;
     bool   inver;
@@ -51,6 +64,8 @@ class QSystem {
 
   enum Bit {NONE, ZERO, ONE};
 
+  using cache_list = std::list<std::pair<std::string, arma::sp_cx_mat>>;
+
   public:
     //! Constructor 
     /*!
@@ -59,14 +74,28 @@ class QSystem {
      * \param nqbits number of qubits in the system.
      * \param gates instance of class Gates that holds the gates used in the
      * method QSystem::evol.
-     * \param seed for the pseudorandom number generator.
+     * \param seed for the pseudorandom number generator, owned by the
+     * instance.
      * \param state representation of the system, use `"vector"` for vector.
      * state and `"matrix"` for density matrix
+     * \param storage memory layout of the state, use `"sparse"` for a sparse
+     * matrix, `"dense"` for a 64-byte aligned array or `"auto"` to change
+     * between them as the state fills up or empties. Gates and channels run
+     * on the layout of the state: a `"sparse"` state is never made dense,
+     * and an `"auto"` one only when a gate could fill it past the dense
+     * threshold.
+     * \param reserve number of ancillas that QSystem::add_ancillas can add
+     * in place. The dense buffer is allocated for `nqbits+reserve` qubits and,
+     * once allocated, is kept dense even in `"auto"` storage. It can not be
+     * used with `"sparse"` storage, and `nqbits+reserve` must be up to 63
+     * for a vector and 31 for a density matrix.
      */
     QSystem(size_t nqbits,
              Gates& gates,
             size_t seed=42,
-       std::string state="vector");
+       std::string state="vector",
+       std::string storage="auto",
+            size_t reserve=0);
 
     ~QSystem();
     
@@ -86,6 +115,22 @@ class QSystem {
                    size_t qbit, 
                    size_t count=1,
                      bool inver=false);
+
+    //! Apply a quantum gate in a list of qubits
+    /*!
+     * The qubit `qbits[i]` takes the place of the i-th qubit of the gate, so
+     * the qubits do not need to be contiguous or in order. Only the
+     * amplitudes of the listed qubits are combined, whatever the distance
+     * between them.
+     *
+     * \param gate name of the gate that will be user.
+     * \param qbits qubits affected by the gate.
+     * \param inver if true, apply the inverse quantum gate.
+     * \sa QSystem::evol QSystem::controlled
+     */
+    void evol(std::string gate,
+               vec_size_t qbits, 
+                     bool inver=false);
     //! Apply a controlled not 
     /*!
      * Apply a not in the `target` qubit if all the `control` qubits are in the
@@ -110,6 +155,41 @@ class QSystem {
      */
     void cphase(complex phase, size_t target, vec_size_t control);
 
+    //! Apply a controlled quantum gate
+    /*!
+     * Apply any quantum gate from the Gates class in the qubits `target` to
+     * `target+(size of the gate)-1` if all the `control` qubits are in the
+     * state \f$\left|1\right>\f$. Only the amplitudes whare the control
+     * qubits are \f$\left|1\right>\f$ are visited and the controlled
+     * matrix is never built.
+     *
+     * \param gate name of the gate, like in QSystem::evol.
+     * \param target first qubit affected by the gate.
+     * \param control list of control qubits, outside of the gate qubits.
+     * \param inver if true, apply the inverse quantum gate.
+     * \sa QSystem::evol QSystem::cnot QSystem::cphase
+     */
+    void controlled(std::string gate,
+                         size_t target,
+                     vec_size_t control,
+                           bool inver=false);
+
+    //! Apply a controlled quantum gate in a list of qubits
+    /*!
+     * Like QSystem::controlled, but the qubit `targets[i]` takes the place of
+     * the i-th qubit of the gate.
+     *
+     * \param gate name of the gate, like in QSystem::evol.
+     * \param targets qubits affected by the gate.
+     * \param control list of control qubits, not in `targets`.
+     * \param inver if true, apply the inverse quantum gate.
+     * \sa QSystem::evol QSystem::controlled
+     */
+    void controlled(std::string gate,
+                     vec_size_t targets,
+                     vec_size_t control,
+                           bool inver=false);
+
     //! Apply a quantum Fourier transformation
     /*!
      * Apply the QFT in the range of qubits (`qbegin`, `qend`].
@@ -127,6 +207,21 @@ class QSystem {
      * \sa QSystem::evol QSystem::cnot QSystem::cphase QSystem::qft
      */
     void swap(size_t qbit_a, size_t qbit_b);
+
+    //! Run a recorded circuit
+    /*!
+     * Apply all the operations recorded in `circuit`, with the angles of
+     * the rotations taken from `params`. The circuit was validated when
+     * recorded, so the operations are applied without crossing to Python
+     * or being checked again, which makes running the same circuit for
+     * many parameter lists cheap.
+     *
+     * \param circuit recorded circuit, with the same number of qubits and
+     * the same Gates of the system.
+     * \param params list of angles used by the parameterized operations.
+     * \sa Circuit
+     */
+    void run(Circuit &circuit, vec_float params=vec_float{});
     
     //! Measure qubits in the computational base
     /*!
@@ -139,6 +234,20 @@ class QSystem {
      */
     void measure(size_t qbit, size_t count=1);
 
+    //! Reset a qubit to the state \f$\left|0\right>\f$
+    /*!
+     * The qubit keeps its place in the system and can be used again. In
+     * vector representation the qubit is measured and, if the result is 1,
+     * flipped, the result stays accessible throw the QSystem::bits method.
+     * In density matrix representation the qubit is traced out and replaced
+     * by \f$\left|0\right>\f$, without being measured. The state is
+     * changed in place.
+     *
+     * \param qbit qubit reset.
+     * \sa QSystem::measure QSystem::rm_ancillas
+     */
+    void reset(size_t qbit);
+
     //! Measure all qubits in the computational base
     /*!
      * The measurements results are assessable throw the QSystem::bits method.
@@ -156,6 +265,42 @@ class QSystem {
      * \sa QSystem::measure QSystem::measure_all
      */
     vec_int bits();
+
+    //! Sample measurements without collapsing the state
+    /*!
+     * Draw `shots` measurements of the qubits in `qbits` from the current
+     * state, that is not changed. The distribution is built once and all
+     * the shots are drawn in a single sweep of it, so many shots cost about
+     * the same as one measurement.
+     *
+     * The result of a shot is packed in an integer whare `qbits[0]` is the
+     * most significant bit. 
+     *
+     * \param qbits qubits sampled.
+     * \param shots number of measurements.
+     * \return Dictionary from the packed results to the number of times
+     * they were drawn.
+     * \sa QSystem::measure QSystem::measure_all
+     */
+    PyObject* sample(vec_size_t qbits, size_t shots);
+
+    //! Get the expectation value of a sum of Pauli strings
+    /*!
+     * Evaluate \f$\left<\psi\right|H\left|\psi\right>\f$, or
+     * \f$\text{Tr}(\rho H)\f$ for density matrix, whare \f$H = \sum_i
+     * \text{coeffs}[i]P_i\f$ and \f$P_i\f$ = `terms[i]`. The character `j`
+     * of a term, ```'I'```, ```'X'```, ```'Y'``` or ```'Z'```, acts on the
+     * qubit `j`, and a term shorter than the system is completed with
+     * ```'I'```. The state is not changed and no gate is applied, the terms
+     * with ```'X'``` or ```'Y'``` in the same qubits are evaluated in a
+     * single pass over the state.
+     *
+     * \param terms list of Pauli strings, *e.g.* `["ZZI", "XIX"]`.
+     * \param coeffs list of real coefficients.
+     * \return Expectation value.
+     * \sa QSystem::sample
+     */
+    double expectation(vec_str terms, vec_float coeffs);
     
     //! Apply a bit, phase or bit-phase flip error
     /*!
@@ -185,17 +330,16 @@ class QSystem {
      *    E_1 = \begin{bmatrix}0&0\\ \sqrt{p}&0\end{bmatrix},
      * \f]
      *
-     * The system must be in density matrix representation to use this method,
-     * otherwise you can use the flow code to achieve a similar result:
-     * ```python
-     * def amp_damping(q, qbit, p):
-     *    from random import choices
-     *    if choices([True, False], weights=[p, 1-p])[0]:
-     *        q.measure(qbit)
-     *        if q.bits[qbit] == 1:
-     *            q.evol('X', qbit)
-     * ```
+     * In vector representation one of the Kraus operators \f$E_k\f$ is
+     * chosen at random, with probability
+     * \f$\left<\psi\right|E_k^\dagger E_k\left|\psi\right>\f$, and the
+     * state is normalized after it is applied. The system then follows one
+     * quantum trajectory, and the average over many trajectories, taken by
+     * QSystem::trajectory_expectation or QSystem::trajectory_sample, gives
+     * the results of the density matrix.
      *
+     * \param qbit qubit effected by the error.
+     * \param p probability of the decay.
      * \sa QSystem::flip QSystem::dpl_channel QSystem::sum
      */
     void amp_damping(size_t qbit, double p);
@@ -209,7 +353,8 @@ class QSystem {
      * \f]
      * that takes the qubit to the maximally mixed state with probability `p`.
      *
-     * The system must be in density matrix representation to use this method.
+     * In vector representation one of the Pauli operators is applied at
+     * random, as in QSystem::amp_damping.
      *
      * \param qbit qubit effected by the error.
      * \param p probability of the error occur.
@@ -232,16 +377,14 @@ class QSystem {
      * U_{mn}\f$] and 
      * * `p` = [\f$p_1,\,p_2,\,\dots,\,p_m\f$]
      *
-     * The system must be in density matrix representation to use this method,
-     * otherwise you can use the flow code to achieve a similar result:
-     * ```python
-     * def sum(q, qbit, kraus, p):
-     *     from random import choices
-     *     aux = 0
-     *     for gate in choices(kraus, weights=p)[0]:
-     *         q.evol(gate, qbit+aux)
-     *         aux += 1
-     * ```
+     * An item of `kraus` can also be the name of a multiple qubits gate. To
+     * apply the same operators many times, use Gates::make_channel and
+     * QSystem::channel.
+     *
+     * In vector representation the operator \f$E_k\f$ is chosen at random,
+     * with probability \f$p_k\left<\psi\right|U_k^\dagger
+     * U_k\left|\psi\right>\f$ normalized by the sum of all of them, as in
+     * QSystem::amp_damping.
      *
      * \param qbit first qubit effected by the error.
      * \param kraus Kraus operators list.
@@ -250,6 +393,74 @@ class QSystem {
      */
     void sum(size_t qbit, vec_str kraus, vec_float p);
 
+    //! Apply a quantum channel
+    /*!
+     * Apply a channel created by Gates::make_channel in the qubits `qbit` to
+     * `qbit+(size of the channel)-1`. The superoperator of the channel is
+     * compiled only once, so applying the same channel many times, like a
+     * noise after every layer of a circuit, costs one pass over the density
+     * matrix each.
+     *
+     * In vector representation a single Kraus operator of the channel is
+     * applied, chosen at random as in QSystem::sum.
+     *
+     * \param name of the channel.
+     * \param qbit first qubit effected by the channel.
+     * \sa Gates::make_channel QSystem::sum
+     */
+    void channel(std::string name, size_t qbit);
+
+    //! Average a Pauli observable over quantum trajectories
+    /*!
+     * Run `circuit` from the current state `ntraj` times, each one in a new
+     * state vector where the noise channels recorded in the circuit apply a
+     * single Kraus operator chosen at random, and return the average of
+     * QSystem::expectation over the trajectories. This approximates the
+     * density matrix simulation of the circuit using \f$2^n\f$ amplitudes
+     * per thread instead of \f$4^n\f$.
+     *
+     * The trajectories are split among the threads set by
+     * QSystem::set_threads. Trajectory `i` draws its numbers from its own
+     * stream of the generator of the system, so the result is the same for
+     * any number of threads. The state of the system is not changed.
+     *
+     * \param circuit recorded circuit, with the same number of qubits and
+     * the same Gates of the system.
+     * \param ntraj number of trajectories.
+     * \param terms Pauli strings, as in QSystem::expectation.
+     * \param coeffs coefficient of each Pauli string.
+     * \param params list of angles used by the parameterized operations.
+     * \return Average of the expectation value.
+     * \sa QSystem::trajectory_sample QSystem::run
+     */
+    double trajectory_expectation(Circuit &circuit,
+                                     size_t ntraj,
+                                    vec_str terms,
+                                  vec_float coeffs,
+                                  vec_float params=vec_float{});
+
+    //! Sample measurements over quantum trajectories
+    /*!
+     * Like QSystem::trajectory_expectation, but `shots` measurements of the
+     * qubits `qbits` are sampled, as in QSystem::sample, and spread evenly
+     * over the trajectories.
+     *
+     * \param circuit recorded circuit, with the same number of qubits and
+     * the same Gates of the system.
+     * \param ntraj number of trajectories.
+     * \param qbits measured qubits, `qbits[0]` is the most significant bit
+     * of the results.
+     * \param shots total number of measurements.
+     * \param params list of angles used by the parameterized operations.
+     * \return Dictionary with the counts of each result.
+     * \sa QSystem::trajectory_expectation QSystem::sample
+     */
+    PyObject* trajectory_sample(Circuit &circuit,
+                                   size_t ntraj,
+                               vec_size_t qbits,
+                                   size_t shots,
+                                vec_float params=vec_float{});
+
     //! Get system state in a string
     /*!
      *  This method is used in Python to cast a instance to `str`.
@@ -277,6 +488,56 @@ class QSystem {
      */
     std::string state();
 
+    //! Get the current memory layout of the state
+    /*!
+     * With `storage="auto"` the layout changes to dense when more than a
+     * quarter of the amplitudes are non-zero, or a gate could make them so,
+     * and back to sparse when less than a sixteenth are.
+     *
+     * \return `"sparse"` or `"dense"`.
+     * \sa QSystem::QSystem QSystem::state
+     */
+    std::string storage();
+
+    //! Set the number of threads used by this system
+    /*!
+     * Gates, measurements and noise channels split the state in blocks that
+     * are processed by a pool of worker threads shared by all instances. The
+     * blocks have a fixed size, so the results do not depend on the number
+     * of threads. The default is one thread.
+     *
+     * \param nthreads number of threads, use 0 for all hardware threads.
+     * \sa QSystem::threads
+     */
+    void set_threads(size_t nthreads);
+
+    //! Get the number of threads used by this system
+    /*!
+     * \return Number of threads.
+     * \sa QSystem::set_threads
+     */
+    size_t threads();
+
+    //! Set the memory used to cache operators
+    /*!
+     * The operators built for cnot, cphase, swap and qft, that are needed
+     * when these gates are fused with others, are kept in a cache and
+     * reused by the next gates with the same qubits, phase and inversion.
+     * When the cache is full the least recently used operator is removed.
+     * The default is 64 MiB.
+     *
+     * \param nbytes memory limit in bytes, use 0 to disable the cache.
+     * \sa QSystem::cache
+     */
+    void set_cache(size_t nbytes);
+
+    //! Get the memory limit of the operator cache
+    /*!
+     * \return Memory limit in bytes.
+     * \sa QSystem::set_cache
+     */
+    size_t cache();
+
     //! Save the quantum state in a file
     /*!
      * The file is in a machine dependent binary format defined by the library
@@ -355,24 +616,27 @@ class QSystem {
     //! Add ancillary qubits
     /*!
      * The ancillaries qubits are added to the end of the system and can be used in 
-     * any method.
+     * any method. Ancillas can be added while others are in use, the new ones
+     * are placed after them. If the dense state fits in the capacity reserved
+     * in the constructor, the amplitudes are spread in place without copying
+     * the state.
      *
      * \param nqbits number of ancillas added.
      * \sa QSystem::rm_ancillas
      */
     void add_ancillas(size_t nqbits);
 
-    //! Remove all ancillary qubits
+    //! Remove ancillary qubits
     /*!
      * If the state is in vector representation the ancillas are measured
      * before been removed. If the state is in density matrix representation,
      * the ancillas are removed by a partial trace operation, without been
-     * measured.
+     * measured. The last added ancillas are removed first.
      *
-     * \param nqbits number of ancillas added.
-     * \sa QSystem::rm_ancillas
+     * \param count number of ancillas removed, all of them if 0.
+     * \sa QSystem::add_ancillas
      */
-    void rm_ancillas();
+    void rm_ancillas(size_t count=0);
 
   private:
     /* src/qs_evol.cpp */
@@ -380,11 +644,137 @@ class QSystem {
     void            sync(size_t qbegin, size_t qend);
     Gate_aux&       ops(size_t index);
     arma::sp_cx_mat get_gate(Gate_aux &op);
+    std::string     op_key(Gate_aux &op);
+    void            cache_put(std::string key, const arma::sp_cx_mat &m);
     cut_pair        cut(size_t &target, vec_size_t &control);
-    void            fill(Gate_aux::Tag tag, size_t qbit, size_t size_n);
+    void            fill(Gate_aux::Tag tag,
+                                size_t qbit,
+                                size_t size_n,
+                     Gate_aux::op_data data='I',
+                                  bool inver=false);
+    void            fuse(size_t qbit, char gate, bool inver);
+    size_t          op_begin(size_t qbit);
+    bool            pending(size_t qbit, size_t size_n, arma::sp_cx_mat &m);
+    bool            fusable(Gate_aux &op);
+    void            place(Gate_aux::Tag tag,
+                                 size_t qbit,
+                                 size_t size_n,
+                      Gate_aux::op_data data,
+                                   bool inver);
+    bool            diagonal(Gate_aux &op,
+                                size_t qbit,
+                std::vector<diag_term> &terms);
+    bool            merge_diag(size_t qbit,
+                               size_t size_n,
+               std::vector<diag_term> terms);
+    bool            permute(Gate_aux &op, size_t qbit);
+    bool            permute(std::string gate,
+                       const vec_size_t &qbits,
+                                   bool inver,
+                                 size_t control);
+    size_t          op_control(std::string gate, const vec_size_t &qbits);
+    void            fill_list(std::string gate,
+                               vec_size_t targets,
+                               vec_size_t control,
+                                     bool inver);
+    void            apply_op(Gate_aux &op, size_t qbit);
+    void            apply_sparse_op(Gate_aux &op, size_t qbit);
+
+    /* src/qs_errors.cpp */
+    void            apply_kraus(size_t qbit, const arma::sp_cx_mat &super);
+    void            apply_jump(size_t qbit,
+             const std::vector<arma::sp_cx_mat> &kraus,
+                             const vec_float &p);
+
+    /* src/qs_kernel.cpp */
+    void            apply_gate(complex *amps,
+                                size_t qbit,
+                 const arma::sp_cx_mat &gate,
+                                size_t control=0);
+    void            apply_gate(complex *amps,
+                      const vec_size_t &qbits,
+                 const arma::sp_cx_mat &gate,
+                                size_t control=0);
+    void            apply_gate(complex *amps,
+                                size_t nqbits,
+                      const vec_size_t &strides,
+                 const arma::sp_cx_mat &gate,
+                                  bool conj,
+                                size_t control);
+    void            apply_super(complex *amps,
+                       const vec_size_t &qbits,
+                  const arma::sp_cx_mat &super);
+    void            apply_sparse(const vec_size_t &targets,
+                            const arma::sp_cx_mat &gate,
+                                           size_t control);
+    void            apply_sparse_super(const vec_size_t &targets,
+                                  const arma::sp_cx_mat &super);
+    void            apply_sparse_diag(const std::vector<diag_term> &terms);
+    void            apply_1(complex *amps,
+                             size_t nqbits,
+                             size_t stride,
+                      const complex *u);
+    void            apply_2(complex *amps,
+                             size_t nqbits,
+                             size_t stride_hi,
+                             size_t stride_lo,
+                      const complex *u);
+    void            apply_n(complex *amps,
+                             size_t nqbits,
+                   const vec_size_t &strides,
+              const arma::sp_cx_mat &gate,
+                               bool conj,
+                             size_t control);
+    void            apply_ctrl(complex *amps,
+                                size_t nqbits,
+                                size_t control,
+                                size_t target,
+                         const complex *u);
+    void            apply_diag(complex *amps,
+                const std::vector<diag_term> &terms);
+    void            apply_diag(complex *amps,
+                                size_t nqbits,
+                const std::vector<diag_mask> &masks);
+    void            apply_perm(complex *amps,
+                      const vec_size_t &qbits,
+                      const vec_size_t &perm,
+                                size_t control);
+    void            apply_perm(complex *amps,
+                                size_t nqbits,
+                      const vec_size_t &strides,
+                      const vec_size_t &perm,
+                                size_t control);
+    void            apply_cnot(complex *amps,
+                                size_t control,
+                                size_t target);
+    void            apply_cnot(complex *amps,
+                                size_t nqbits,
+                                size_t control,
+                                size_t target);
+    void            apply_swap(complex *amps,
+                                size_t mask_a,
+                                size_t mask_b);
+    void            apply_swap(complex *amps,
+                                size_t nqbits,
+                                size_t mask_a,
+                                size_t mask_b);
+    void            apply_qft(complex *amps,
+                               size_t qbit,
+                               size_t size_n,
+                                 bool inver);
+    void            apply_qft(complex *amps,
+                               size_t nqbits,
+                               size_t low,
+                               size_t size_n,
+                                 bool inver);
+    void            parallel(size_t n,
+             const std::function<void(size_t, size_t)> &f);
+    double          parallel_sum(size_t n,
+             const std::function<double(size_t, size_t)> &f);
+    vec_float       parallel_partial(size_t n,
+             const std::function<double(size_t, size_t)> &f);
 
     /* src/qs_make.cpp */
-    arma::sp_cx_mat make_gate(arma::sp_cx_mat gate, size_t qbit);
     arma::sp_cx_mat make_cnot(size_t target,
                           vec_size_t control,
                               size_t size_n);
@@ -394,6 +784,35 @@ class QSystem {
                                  size_t size_n);
     arma::sp_cx_mat make_swap(size_t size_n);
     arma::sp_cx_mat make_qft(size_t size_n);
+    arma::sp_cx_mat make_controlled(const arma::sp_cx_mat &gate,
+                                               vec_size_t targets,
+                                               vec_size_t control,
+                                                   size_t size_n);
+    arma::sp_cx_mat make_diag(const std::vector<diag_term> &terms,
+                                                 size_t size_n);
+
+    /* src/qs_measure.cpp */
+    vec_size_t      draw(vec_float r);
+    void            collapse(size_t mask, size_t result);
+    std::map<size_t, size_t> counts(const vec_size_t &qbits, size_t shots);
+    PyObject*       to_dict(const std::map<size_t, size_t> &counts);
+
+    /* src/qs_storage.cpp */
+    void            to_dense();
+    void            to_sparse();
+    void            adapt_storage();
+    arma::sp_cx_mat sparse_qbits();
+    void            store(arma::sp_cx_mat m);
+    bool            sparse_fits(size_t growth);
+    bool            sparse_fits(const arma::sp_cx_mat &gate,
+                                           bool super=false);
+    size_t          reserved(size_t n_cols);
+
+    /* src/qs_trajectory.cpp */
+    void            trajectories(Circuit &circuit,
+                                  size_t ntraj,
+                        const vec_float &params,
+        const std::function<void(size_t, QSystem&)> &f);
 
     /* src/qs_utility.cpp */
     void            clear();
@@ -405,22 +824,40 @@ class QSystem {
     Gate_aux*       _ops;
     bool            _sync;
     arma::sp_cx_mat qbits;
+    Amplitudes      dqbits;
+    std::string     _storage;
+    bool            _dense;
+    size_t          _threads;
+    Philox          _rng;
+    cache_list      _cache;
+    std::unordered_map<std::string, cache_list::iterator> _cache_map;
+    size_t          _cache_bytes;
+    size_t          _cache_max;
     Bit*            _bits;
 
     size_t          an_size;
+    size_t          _reserve;
     Gate_aux*       an_ops;
     Bit*            an_bits;
 
     inline void     valid_qbit(std::string name, size_t qbit);
     inline void     valid_count(size_t qbit, size_t count, size_t size_n=1);
     inline void     valid_control(vec_size_t &control);
+    inline void     valid_targets(std::string &gate,
+                                   vec_size_t &targets,
+                                   vec_size_t &control);
     inline void     valid_phase(complex phase);
     inline void     valid_swap(size_t qbit_a, size_t qbit_b);
     inline void     valid_range(size_t qbegin, size_t qend);
     inline void     valid_gate(char gate);
     inline void     valid_p(double p);
-    inline void     valid_state();
-    inline void     valid_krau(vec_str &kraus);
+    inline void     valid_krau(std::vector<arma::sp_cx_mat> &kraus,
+                                                  vec_float &p);
+    inline void     valid_sample(vec_size_t &qbits, size_t shots);
+    inline void     valid_pauli(vec_str &terms, vec_float &coeffs);
+    inline void     valid_circuit(Circuit &circuit, vec_float &params);
+    inline void     valid_trajectories(size_t ntraj);
+    inline void     valid_reserve(std::string state, size_t nqbits);
 
 };
 
@@ -436,7 +873,7 @@ inline void QSystem::valid_qbit(std::string name, size_t qbit) {
 
 /******************************************************/
 inline void QSystem::valid_count(size_t qbit, size_t count, size_t size_n) {
-  if (count == 0 and qbit+count*size_n <= size()) {
+  if (count == 0 or qbit+count*size_n > size()) {
       sstr err;
       err << "\'cout\' argument should be greater than 0 "
           << "and \'qbit+count\' suld be in the range of 0 to "
@@ -462,6 +899,30 @@ inline void QSystem::valid_control(vec_size_t &control) {
   }
 }
 
+/******************************************************/
+inline void QSystem::valid_targets(std::string &gate,
+                                    vec_size_t &targets,
+                                    vec_size_t &control) {
+  size_t size_n = gate.size() == 1? log2(gates.get(gate[0]).n_rows)
+                                  : log2(gates.mget(gate).n_rows);
+  if (targets.size() != size_n) {
+    sstr err;
+    err << "\'" << gate << "\' affects " << size_n << " qubits, "
+        << "but " << targets.size() << " were given";
+    throw std::invalid_argument{err.str()};
+  }
+  for (size_t i = 0; i < targets.size(); i++) {
+    valid_qbit("targets", targets[i]);
+    if (std::count(targets.begin(), targets.end(), targets[i]) > 1
+        or std::count(control.begin(), control.end(), targets[i]) > 0) {
+      sstr err;
+      err << "Qubit " << targets[i] << " repeated in the target or "
+          << "control qubits";
+      throw std::invalid_argument{err.str()};
+    }
+  }
+}
+
 /******************************************************/
 inline void QSystem::valid_phase(complex phase) {
   if (std::abs(std::abs(phase) - 1.0) > 1e-14) {
@@ -511,18 +972,17 @@ inline void QSystem::valid_p(double p) {
   }
 }
 
-inline void QSystem::valid_state() {
-  if (_state == "vector") {
+inline void QSystem::valid_krau(std::vector<arma::sp_cx_mat> &kraus,
+                                                   vec_float &p) {
+  if (kraus.size() == 0 or kraus.size() != p.size()) {
     sstr err;
-    err << "\'state\' must be in \"matrix\" to apply this channel";
-    throw std::runtime_error{err.str()};
+    err << "Arguments \'kraus\' and \'p\' must have the same size, "
+        << "greater than 0";
+    throw std::invalid_argument{err.str()};
   }
-}
-
-inline void QSystem::valid_krau(vec_str &kraus) {
-  size_t ksize = kraus[0].size();
+  size_t ksize = kraus[0].n_rows;
   for (auto& k : kraus) {
-    if (k.size() != ksize) {
+    if (k.n_rows != ksize) {
       sstr err;
       err << "All \'kraus\' operators must have the same size";
       throw std::runtime_error{err.str()};
@@ -530,3 +990,85 @@ inline void QSystem::valid_krau(vec_str &kraus) {
   }
 }
 
+/******************************************************/
+inline void QSystem::valid_sample(vec_size_t &qbits, size_t shots) {
+  if (qbits.size() == 0 or qbits.size() > 64 or shots == 0) {
+    sstr err;
+    err << "\'qbits\' argument must have 1 to 64 items "
+        << "and \'shots\' should be greater than 0";
+    throw std::invalid_argument{err.str()};
+  }
+  for (auto& i : qbits) {
+    valid_qbit("qbits", i);
+    if (std::count(qbits.begin(), qbits.end(), i) > 1) {
+      sstr err;
+      err << "Qubit " << i << " repeated in \'qbits\'";
+      throw std::invalid_argument{err.str()};
+    }
+  }
+}
+
+/******************************************************/
+inline void QSystem::valid_pauli(vec_str &terms, vec_float &coeffs) {
+  if (terms.size() != coeffs.size()) {
+    sstr err;
+    err << "Arguments \'terms\' and \'coeffs\' must have the same size";
+    throw std::invalid_argument{err.str()};
+  }
+  for (auto& t : terms) {
+    if (t.size() > size() 
+        or t.find_first_not_of("IXYZ") != std::string::npos) {
+      sstr err;
+      err << "Items in \'terms\' must have up to " << size() 
+          << " characters \'I\', \'X\', \'Y\' or \'Z\'";
+      throw std::invalid_argument{err.str()};
+    }
+  }
+}
+
+/******************************************************/
+inline void QSystem::valid_circuit(Circuit &circuit, vec_float &params) {
+  if (circuit.size() != size() or params.size() < circuit.params()) {
+    sstr err;
+    err << "\'circuit\' must have " << size() << " qubits "
+        << "and \'params\' must have at least " << circuit.params() 
+        << " items";
+    throw std::invalid_argument{err.str()};
+  }
+  /* the gate names of the circuit were checked against its own Gates */
+  if (&circuit.gates != &gates) {
+    sstr err;
+    err << "\'circuit\' must be recorded with the same Gates of the system";
+    throw std::invalid_argument{err.str()};
+  }
+}
+
+/******************************************************/
+inline void QSystem::valid_trajectories(size_t ntraj) {
+  if (_state != "vector" or ntraj == 0) {
+    sstr err;
+    err << "\'state\' must be in \"vector\" to run trajectories "
+        << "and \'ntraj\' should be greater than 0";
+    throw std::invalid_argument{err.str()};
+  }
+}
+
+/******************************************************/
+inline void QSystem::valid_reserve(std::string state, size_t nqbits) {
+  if (_reserve == 0) return;
+
+  if (_storage == "sparse") {
+    sstr err;
+    err << "\'reserve\' argument needs \"dense\" or \"auto\" storage";
+    throw std::invalid_argument{err.str()};
+  }
+
+  /* the dense buffer of nqbits+reserve qubits must be indexable */
+  size_t max_qbits = state == "matrix"? 31 : 63;
+  if (nqbits+_reserve > max_qbits) {
+    sstr err;
+    err << "\'nqbits+reserve\' must be up to " << max_qbits 
+        << " for a state in \"" << state << "\"";
+    throw std::invalid_argument{err.str()};
+  }
+}
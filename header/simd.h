@@ -0,0 +1,49 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */     
+
+#pragma once
+#include "using.h"
+
+//! Vectorized amplitude kernels
+/*!
+ * Apply a 2x2 or 4x4 matrix, stored column-major, to the amplitude pairs or
+ * quads selected by the strides. The range [`begin`, `end`) counts pairs
+ * (or quads), so that the work can be split in independent blocks. The
+ * implementation (AVX-512, AVX2 or scalar) is chosen at runtime from the CPU
+ * features.
+ */
+namespace simd {
+  void apply_1(complex *amps,
+                size_t stride,
+         const complex *u,
+                size_t begin,
+                size_t end);
+
+  void apply_2(complex *amps,
+                size_t stride_hi,
+                size_t stride_lo,
+         const complex *u,
+                size_t begin,
+                size_t end);
+}
@@ -37,5 +37,8 @@ using vec_int = std::vector<int>;
 using vec_float = std::vector<double>;
 using cnot_pair = std::pair<size_t, vec_size_t>;
 using cph_tuple = std::tuple<complex, size_t, vec_size_t>;
+using ctrl_tuple = std::tuple<std::string, vec_size_t, vec_size_t>;
 using cut_pair = std::pair<size_t, size_t>;
+using diag_term = std::pair<vec_size_t, vec_complex>;
+using diag_mask = std::pair<size_t, vec_complex>;
 using sstr = std::stringstream;
@@ -6,16 +6,26 @@ with open('README.md', 'r') as fh:
 
 ext_module = Extension('_qsystem',
         sources=['src/qsystem.cpp',
+                 'src/amplitudes.cpp',
+                 'src/builder.cpp',
+                 'src/circuit.cpp',
                  'src/gates.cpp',
                  'src/microtar.c', 
+                 'src/philox.cpp',
                  'src/qs_ancillas.cpp',
                  'src/qs_errors.cpp',
                  'src/qs_evol.cpp',
+                 'src/qs_kernel.cpp',
                  'src/qs_make.cpp',
                  'src/qs_measure.cpp',
-                 'src/qs_utility.cpp'],
+                 'src/qs_storage.cpp',
+                 'src/qs_trajectory.cpp',
+                 'src/qs_utility.cpp',
+                 'src/pool.cpp',
+                 'src/simd.cpp'],
         include_dirs=['armadillo-code/include'],
-        extra_compile_args=['-std=c++17']
+        extra_compile_args=['-std=c++17', '-pthread'],
+        extra_link_args=['-pthread']
         )
 
 setup (name = 'QSystem',
@@ -0,0 +1,104 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#include "../header/amplitudes.h"
+#include <algorithm>
+#include <cstdlib>
+
+/*********************************************************/
+Amplitudes::Amplitudes() : n_rows{0}, n_cols{0}, n_elem{0}, n_alloc{0}, mem{nullptr} {}
+
+/*********************************************************/
+Amplitudes::Amplitudes(size_t n_rows, size_t n_cols, size_t capacity) :
+  n_rows{n_rows},
+  n_cols{n_cols},
+  n_elem{n_rows*n_cols},
+  n_alloc{std::max(n_rows*n_cols, capacity)}
+{
+  size_t bytes = (n_alloc*sizeof(complex)+63) & ~63ul;
+  mem = static_cast<complex*>(std::aligned_alloc(64, bytes));
+  if (not mem) 
+    throw std::bad_alloc{};
+  std::fill(mem, mem+n_elem, complex{0});
+}
+
+/*********************************************************/
+Amplitudes::Amplitudes(Amplitudes &&other) :
+  n_rows{other.n_rows},
+  n_cols{other.n_cols},
+  n_elem{other.n_elem},
+  n_alloc{other.n_alloc},
+  mem{other.mem}
+{
+  other.n_rows = other.n_cols = other.n_elem = other.n_alloc = 0;
+  other.mem = nullptr;
+}
+
+/*********************************************************/
+Amplitudes::~Amplitudes() {
+  std::free(mem);
+}
+
+/*********************************************************/
+Amplitudes& Amplitudes::operator=(Amplitudes &&other) {
+  if (this != &other) {
+    std::free(mem);
+    n_rows = other.n_rows;
+    n_cols = other.n_cols;
+    n_elem = other.n_elem;
+    n_alloc = other.n_alloc;
+    mem = other.mem;
+    other.n_rows = other.n_cols = other.n_elem = other.n_alloc = 0;
+    other.mem = nullptr;
+  }
+  return *this;
+}
+
+/*********************************************************/
+complex* Amplitudes::memptr() {
+  return mem;
+}
+
+/*********************************************************/
+arma::cx_mat Amplitudes::mat() {
+  return arma::cx_mat(mem, n_rows, n_cols, false, true);
+}
+
+/*********************************************************/
+size_t Amplitudes::capacity() {
+  return n_alloc;
+}
+
+/*********************************************************/
+void Amplitudes::reshape(size_t n_rows, size_t n_cols) {
+  if (n_rows*n_cols > n_alloc) {
+    sstr err;
+    err << "Can not reshape to " << n_rows << "x" << n_cols
+        << ", the buffer only holds " << n_alloc << " amplitudes";
+    throw std::length_error{err.str()};
+  }
+  this->n_rows = n_rows;
+  this->n_cols = n_cols;
+  n_elem = n_rows*n_cols;
+}
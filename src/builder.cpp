@@ -0,0 +1,90 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#include "../header/builder.h"
+#include <algorithm>
+
+using namespace arma;
+
+/*********************************************************/
+SpBuilder::SpBuilder(size_t n_rows, size_t n_cols, size_t nnz) 
+  : n_rows{n_rows}, n_cols{n_cols} {
+  rows.reserve(nnz);
+  cols.reserve(nnz);
+  values.reserve(nnz);
+}
+
+/*********************************************************/
+void SpBuilder::set(size_t row, size_t col, complex value) {
+  rows.push_back(row);
+  cols.push_back(col);
+  values.push_back(value);
+}
+
+/*********************************************************/
+sp_cx_mat SpBuilder::build(bool add_values) {
+  /* counting sort of the elements by column, that keeps the order in which
+   * they were set */
+  vec_size_t col_ptrs(n_cols+1);
+  for (auto i : cols)
+    col_ptrs[i+1]++;
+  for (size_t i = 0; i < n_cols; i++)
+    col_ptrs[i+1] += col_ptrs[i];
+
+  vec_size_t order(rows.size());
+  vec_size_t next(col_ptrs.begin(), col_ptrs.end()-1);
+  for (size_t k = 0; k < rows.size(); k++)
+    order[next[cols[k]]++] = k;
+
+  /* in each column the rows are sorted and the repeated elements are
+   * summed or replaced by the last value set */
+  vec_size_t row_indices;
+  vec_complex nonzeros;
+  row_indices.reserve(rows.size());
+  nonzeros.reserve(rows.size());
+  vec_size_t new_ptrs(n_cols+1);
+  for (size_t col = 0; col < n_cols; col++) {
+    auto begin = order.begin()+col_ptrs[col];
+    auto end = order.begin()+col_ptrs[col+1];
+    auto by_row = [&](size_t a, size_t b) { return rows[a] < rows[b]; };
+    if (not std::is_sorted(begin, end, by_row))
+      std::stable_sort(begin, end, by_row);
+    complex value = 0;
+    for (auto k = begin; k != end; ++k) {
+      value = add_values? value+values[*k] : values[*k];
+      if (k+1 != end and rows[*(k+1)] == rows[*k]) continue;
+      if (value != 0.0) {
+        row_indices.push_back(rows[*k]);
+        nonzeros.push_back(value);
+      }
+      value = 0;
+    }
+    new_ptrs[col+1] = row_indices.size();
+  }
+
+  return sp_cx_mat(conv_to<uvec>::from(row_indices),
+                   conv_to<uvec>::from(new_ptrs),
+                   cx_vec(nonzeros),
+                   n_rows, n_cols);
+}
@@ -0,0 +1,332 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#include "../header/circuit.h"
+#include <algorithm>
+
+/*********************************************************/
+Circuit::Circuit(size_t nqbits, Gates& gates) 
+  : nqbits{nqbits}, nparams{0}, gates{gates} {}
+
+/*********************************************************/
+void Circuit::push(Op::Kind kind, size_t qbit, size_t size_n) {
+  Op op{};
+  op.kind = kind;
+  op.qbit = qbit;
+  op.size = size_n;
+  op.scale = 1;
+  ops.push_back(op);
+}
+
+/*********************************************************/
+void Circuit::cut(size_t target, vec_size_t control) {
+  size_t minq = std::min(target, *std::min_element(control.begin(),
+                                                    control.end()));
+  size_t maxq = std::max(target, *std::max_element(control.begin(),
+                                                    control.end()));
+  for (auto &i : control)
+    i -= minq;
+  ops.back().qbit = minq;
+  ops.back().size = maxq-minq+1;
+  ops.back().target = target-minq;
+  ops.back().control = control;
+}
+
+/*********************************************************/
+size_t Circuit::gate_size(std::string gate) {
+  return gate.size() == 1? log2(gates.get(gate[0]).n_rows)
+                         : log2(gates.mget(gate).n_rows);
+}
+
+/*********************************************************/
+void Circuit::evol(std::string gate,
+                        size_t qbit, 
+                        size_t count,
+                          bool inver) {
+  valid_qbit("qbit", qbit);
+  size_t size_n = gate_size(gate);
+  if (count == 0 or qbit+count*size_n > nqbits) {
+    sstr err;
+    err << "\'cout\' argument should be greater than 0 "
+        << "and \'qbit+count\' suld be in the range of 0 to "
+        << nqbits;
+    throw std::invalid_argument{err.str()};
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    push(gate.size() == 1? Op::GATE_1 : Op::GATE_N, qbit+i*size_n, size_n);
+    ops.back().gate = gate;
+    ops.back().inver = inver;
+  }
+}
+
+/*********************************************************/
+void Circuit::evol(std::string gate, vec_size_t qbits, bool inver) {
+  controlled(gate, qbits, {}, inver);
+}
+
+/*********************************************************/
+void Circuit::cnot(size_t target, vec_size_t control) {
+  valid_qbit("target", target);
+  valid_list("control", control);
+  if (control.size() == 0) {
+    sstr err;
+    err << "\'control\' argument must have at least one item";
+    throw std::invalid_argument{err.str()};
+  }
+
+  push(Op::CNOT, target, 1);
+  cut(target, control);
+}
+
+/*********************************************************/
+void Circuit::cphase(complex phase, size_t target, vec_size_t control) {
+  valid_qbit("target", target);
+  valid_list("control", control);
+  if (control.size() == 0 or std::abs(std::abs(phase) - 1.0) > 1e-14) {
+    sstr err;
+    err << "\'control\' argument must have at least one item "
+        << "and abs(phase) must be equal to 1";
+    throw std::invalid_argument{err.str()};
+  }
+
+  push(Op::CPHASE, target, 1);
+  cut(target, control);
+  ops.back().phase = phase;
+}
+
+/*********************************************************/
+void Circuit::controlled(std::string gate,
+                              size_t target,
+                          vec_size_t control,
+                                bool inver) {
+  valid_qbit("target", target);
+  vec_size_t targets;
+  for (size_t i = 0; i < gate_size(gate); i++)
+    targets.push_back(target+i);
+  controlled(gate, targets, control, inver);
+}
+
+/*********************************************************/
+void Circuit::controlled(std::string gate,
+                          vec_size_t targets,
+                          vec_size_t control,
+                                bool inver) {
+  vec_size_t qbits = targets;
+  qbits.insert(qbits.end(), control.begin(), control.end());
+  valid_list("targets", qbits);
+  if (targets.size() != gate_size(gate)) {
+    sstr err;
+    err << "\'" << gate << "\' affects " << gate_size(gate) << " qubits, "
+        << "but " << targets.size() << " were given";
+    throw std::invalid_argument{err.str()};
+  }
+
+  bool contiguous = control.empty();
+  for (size_t i = 1; i < targets.size(); i++)
+    contiguous = contiguous and targets[i] == targets[0]+i;
+  if (contiguous) {
+    evol(gate, targets[0], 1, inver);
+    return;
+  }
+
+  size_t minq = *std::min_element(qbits.begin(), qbits.end());
+  size_t maxq = *std::max_element(qbits.begin(), qbits.end());
+  for (auto &i : targets)
+    i -= minq;
+  for (auto &i : control)
+    i -= minq;
+
+  push(Op::CONTROLLED, minq, maxq-minq+1);
+  ops.back().gate = gate;
+  ops.back().targets = targets;
+  ops.back().control = control;
+  ops.back().inver = inver;
+}
+
+/*********************************************************/
+void Circuit::qft(size_t qbegin, size_t qend, bool inver) {
+  if (qbegin >= nqbits or qend > nqbits or qbegin >= qend) {
+    sstr err;
+    err << "\'qbegin\' argument should be in the "
+        << "range of 0 to " << (nqbits-1)
+        << " and argument \'qend\' should be greater than \'qbegin\' "
+        << "and in the range of 1 to " << nqbits;
+    throw std::invalid_argument{err.str()};
+  }
+
+  push(Op::QFT, qbegin, qend-qbegin);
+  ops.back().inver = inver;
+}
+
+/*********************************************************/
+void Circuit::swap(size_t qbit_a, size_t qbit_b) {
+  valid_qbit("qbit_a", qbit_a);
+  valid_qbit("qbit_b", qbit_b);
+
+  if (qbit_a == qbit_b) return;
+  size_t a = std::min(qbit_a, qbit_b);
+  size_t b = std::max(qbit_a, qbit_b);
+  push(Op::SWAP, a, b-a+1);
+}
+
+/*********************************************************/
+void Circuit::rot(char axis, size_t qbit, size_t param, double scale) {
+  valid_qbit("qbit", qbit);
+  if (not (axis == 'X' or axis == 'Y' or axis == 'Z')) {
+    sstr err;
+    err << "\'axis\' argument must be equal to \'X\', \'Y\' or \'Z\'";
+    throw std::invalid_argument{err.str()};    
+  }
+
+  push(Op::ROT, qbit, 1);
+  ops.back().axis = axis;
+  ops.back().param = param;
+  ops.back().scale = scale;
+  nparams = std::max(nparams, param+1);
+}
+
+/*********************************************************/
+void Circuit::phase(size_t target,
+                vec_size_t control,
+                    size_t param,
+                    double scale) {
+  valid_qbit("target", target);
+  valid_list("control", control);
+
+  push(Op::PHASE, target, 1);
+  if (not control.empty())
+    cut(target, control);
+  ops.back().param = param;
+  ops.back().scale = scale;
+  nparams = std::max(nparams, param+1);
+}
+
+/*********************************************************/
+void Circuit::measure(size_t qbit, size_t count) {
+  valid_qbit("qbit", qbit);
+  if (count == 0 or qbit+count > nqbits) {
+    sstr err;
+    err << "\'cout\' argument should be greater than 0 "
+        << "and \'qbit+count\' suld be in the range of 0 to "
+        << nqbits;
+    throw std::invalid_argument{err.str()};
+  }
+
+  push(Op::MEASURE, qbit, count);
+}
+
+/*********************************************************/
+void Circuit::noise(size_t qbit,
+      std::vector<arma::sp_cx_mat> kraus,
+                    vec_float p,
+              arma::sp_cx_mat super) {
+  size_t size_n = log2(kraus[0].n_rows);
+  if (qbit+size_n > nqbits) {
+    sstr err;
+    err << "\'qbit+(size of the channel)\' should be in the range of 0 to "
+        << nqbits;
+    throw std::invalid_argument{err.str()};
+  }
+
+  push(Op::NOISE, qbit, size_n);
+  ops.back().kraus = kraus;
+  ops.back().p = p;
+  ops.back().super = super;
+}
+
+/*********************************************************/
+void Circuit::flip(char gate, size_t qbit, double p) {
+  valid_qbit("qbit", qbit);
+  valid_p(p);
+  if (not (gate == 'X' or gate == 'Y' or gate == 'Z')) {
+    sstr err;
+    err << "\'gate\' argument must be equal to \'X\', \'Y\' or \'Z\'";
+    throw std::invalid_argument{err.str()};    
+  }
+
+  noise(qbit, {gates.get('I'), gates.get(gate)}, {1-p, p},
+        Gates::superop({gates.get(gate)}, {p}, 1-p));
+}
+
+/*********************************************************/
+void Circuit::amp_damping(size_t qbit, double p) {
+  valid_qbit("qbit", qbit);
+  valid_p(p);
+
+  noise(qbit, Gates::amp_damping(p), {1, 1}, 
+        Gates::superop(Gates::amp_damping(p), {1, 1}));
+}
+
+/*********************************************************/
+void Circuit::dpl_channel(size_t qbit, double p) {
+  valid_qbit("qbit", qbit);
+  valid_p(p);
+
+  noise(qbit, {gates.get('I'), gates.get('X'), gates.get('Y'), gates.get('Z')},
+        {1-p, p/3, p/3, p/3},
+        Gates::superop({gates.get('X'), gates.get('Y'), gates.get('Z')}, 
+                       {p/3, p/3, p/3}, 1-p));
+}
+
+/*********************************************************/
+void Circuit::sum(size_t qbit, vec_str kraus, vec_float p) {
+  valid_qbit("qbit", qbit);
+  if (kraus.size() == 0 or kraus.size() != p.size()) {
+    sstr err;
+    err << "Arguments \'kraus\' and \'p\' must have the same size, "
+        << "greater than 0";
+    throw std::invalid_argument{err.str()};
+  }
+
+  std::vector<arma::sp_cx_mat> e;
+  for (auto &ops : kraus) {
+    e.push_back(gates.kraus(ops));
+    if (e.back().n_rows != e[0].n_rows) {
+      sstr err;
+      err << "All \'kraus\' operators must have the same size";
+      throw std::invalid_argument{err.str()};
+    }
+  }
+
+  noise(qbit, e, p, Gates::superop(e, p));
+}
+
+/*********************************************************/
+void Circuit::channel(std::string name, size_t qbit) {
+  valid_qbit("qbit", qbit);
+  auto &kraus = gates.channel_kraus(name);
+
+  noise(qbit, kraus.first, kraus.second, gates.channel(name));
+}
+
+/*********************************************************/
+size_t Circuit::size() {
+  return nqbits;
+}
+
+/*********************************************************/
+size_t Circuit::params() {
+  return nparams;
+}
@@ -23,6 +23,7 @@
  */                                                                               
 
 #include "../header/gates.h"
+#include "../header/builder.h"
 #include "../header/microtar.h"
 
 using namespace arma;
@@ -48,7 +49,7 @@ Gates::Gates(std::string path) {
     free(m);
     sp_cx_mat matrix;
     matrix.load(ss, arma_binary);
-    mmap[std::string(h.name)] = matrix;
+    insert(std::string(h.name), matrix);
   }
 
   mtar_close(&tar);
@@ -64,6 +65,134 @@ sp_cx_mat& Gates::mget(std::string gate) {
   return mmap.at(gate);
 }
 
+/*********************************************************/
+sp_cx_mat& Gates::channel(std::string name) {
+  return smap.at(name);
+}
+
+/*********************************************************/
+std::pair<std::vector<sp_cx_mat>, vec_float>& 
+Gates::channel_kraus(std::string name) {
+  return kmap.at(name);
+}
+
+/*********************************************************/
+sp_cx_mat Gates::kraus(std::string ops) {
+  if (mmap.count(ops))
+    return mmap.at(ops);
+
+  sp_cx_mat e = map.at(ops[0]);
+  for (size_t i = 1; i < ops.size(); i++)
+    e = kron(e, map.at(ops[i]));
+  return e;
+}
+
+/*********************************************************/
+sp_cx_mat Gates::superop(const std::vector<sp_cx_mat> &kraus,
+                                           vec_float p,
+                                              double p_id) {
+  size_t dim_n = kraus[0].n_rows;
+  cx_mat super{dim_n*dim_n, dim_n*dim_n};
+  super.zeros();
+  for (size_t i = 0; i < dim_n*dim_n; i++)
+    super(i, i) = p_id;
+  for (size_t k = 0; k < kraus.size(); k++) {
+    cx_mat e{kraus[k]};
+    for (size_t rc = 0; rc < dim_n; rc++)
+      for (size_t cc = 0; cc < dim_n; cc++)
+        for (size_t rr = 0; rr < dim_n; rr++)
+          for (size_t cr = 0; cr < dim_n; cr++)
+            super(rc*dim_n+rr, cc*dim_n+cr) += p[k]*std::conj(e(rc, cc))*e(rr, cr);
+  }
+  return sp_cx_mat{super};
+}
+
+/*********************************************************/
+std::vector<sp_cx_mat> Gates::amp_damping(double p) {
+  sp_cx_mat E0{cx_mat{{{{1, 0}, {0, 0}},
+                       {{0, 0}, {sqrt(1-p), 0}}}}};
+  sp_cx_mat E1{cx_mat{{{{0, 0}, {sqrt(p), 0}},
+                       {{0, 0}, {0, 0}}}}};
+  return {E0, E1};
+}
+
+/*********************************************************/
+static bool is_diagonal(const sp_cx_mat &m) {
+  m.sync();
+  for (size_t col = 0; col < m.n_cols; col++) 
+    for (size_t k = m.col_ptrs[col]; k < m.col_ptrs[col+1]; k++) 
+      if (m.row_indices[k] != col) return false;
+  return true;
+}
+
+/*********************************************************/
+static vec_size_t to_permutation(const sp_cx_mat &m) {
+  m.sync();
+  vec_size_t perm(m.n_cols);
+  std::vector<bool> used(m.n_rows);
+  for (size_t col = 0; col < m.n_cols; col++) {
+    size_t k = m.col_ptrs[col];
+    if (m.col_ptrs[col+1] != k+1 
+        or m.values[k] != 1.0
+        or used[m.row_indices[k]]) 
+      return {};
+    used[m.row_indices[k]] = true;
+    perm[col] = m.row_indices[k];
+  }
+  return perm;
+}
+
+/*********************************************************/
+static size_t to_control(const sp_cx_mat &m) {
+  /* a column outside the control subspace must be the one of the identity,
+   * so the bits of any other column and of its rows are not controls */
+  m.sync();
+  size_t control = m.n_cols-1;
+  for (size_t col = 0; col < m.n_cols; col++) {
+    size_t k = m.col_ptrs[col];
+    if (m.col_ptrs[col+1] == k+1 
+        and m.row_indices[k] == col 
+        and m.values[k] == 1.0) 
+      continue;
+    control &= col;
+    for (; k < m.col_ptrs[col+1]; k++) 
+      control &= m.row_indices[k];
+  }
+  return control;
+}
+
+/*********************************************************/
+bool Gates::diagonal(char gate) {
+  return is_diagonal(map.at(gate));
+}
+
+/*********************************************************/
+bool Gates::mdiagonal(std::string gate) {
+  return is_diagonal(mmap.at(gate));
+}
+
+/*********************************************************/
+vec_size_t Gates::permutation(char gate) {
+  return to_permutation(map.at(gate));
+}
+
+/*********************************************************/
+vec_size_t& Gates::mpermutation(std::string gate) {
+  return pmap.at(gate);
+}
+
+/*********************************************************/
+size_t Gates::mcontrol(std::string gate) {
+  return cmap.at(gate);
+}
+
+/*********************************************************/
+void Gates::insert(std::string name, sp_cx_mat m) {
+  pmap[name] = to_permutation(m);
+  cmap[name] = to_control(m);
+  mmap[name] = m;
+}
+
 /*********************************************************/
 void Gates::make_gate(char name, vec_complex matrix) {
   if (matrix.size() != 4) {
@@ -91,13 +220,13 @@ void Gates::make_mgate(std::string name,
   }
 
   auto sizem = 1ul << size;
-  sp_cx_mat m{sizem, sizem};
+  SpBuilder m{sizem, sizem, row.size()};
 
   for (size_t i = 0; i < row.size(); i++) {
-    m(row[i], col[i]) = value[i];
+    m.set(row[i], col[i], value[i]);
   }
 
-  mmap[name] = m;
+  insert(name, m.build());
 }
 
 /*********************************************************/
@@ -143,22 +272,22 @@ void Gates::make_cgate(std::string name,
     return x & 1; 
   };
 
-  sp_cx_mat cm{1ul << size, 1ul << size};
+  size_t cmask = 0;
+  for (auto i : control)
+    cmask |= 1ul << (size-i-1);
 
-  for (size_t i = 0; i < (1ul << size); i++) {
-    bool cond = true;
-    for (size_t k = 0; k < control.size(); k++)
-      cond = cond and ((1ul << (size-control[k]-1)) & i);
+  SpBuilder cm{1ul << size, 1ul << size, 1ul << size};
 
-    if (cond) {
+  for (size_t i = 0; i < (1ul << size); i++) {
+    if ((i & cmask) == cmask) {
       size_t row = (i ^ x);
-      cm(row, i) = pow(-1, parity(i & z));
+      cm.set(row, i, pow(-1, parity(i & z)));
     } else {
-      cm(i,i) = 1;
+      cm.set(i, i, 1);
     }
   }
 
-  mmap[name] = cm;
+  insert(name, cm.build());
 }
 
 /*********************************************************/
@@ -167,7 +296,7 @@ void Gates::make_fgate(std::string name,
                             size_t size,
                          PyObject* iterator) {
 
-  sp_cx_mat m{1ul << size, 1ul << size};
+  SpBuilder m{1ul << size, 1ul << size, 1ul << size};
 
   if (iterator == Py_None) {
     PyObject *builtins = PyEval_GetBuiltins(); 
@@ -185,7 +314,7 @@ void Gates::make_fgate(std::string name,
     auto i = PyLong_AsSize_t(pyi);
     auto j = PyLong_AsSize_t(pyj);
 
-    m(i, j) = 1;
+    m.set(i, j, 1);
    
     Py_DECREF(pyi);
     Py_DECREF(pyj);
@@ -193,7 +322,30 @@ void Gates::make_fgate(std::string name,
 
   Py_DECREF(it);
 
-  mmap[name] = m;
+  insert(name, m.build());
+}
+
+/*********************************************************/
+void Gates::make_channel(std::string name, vec_str kraus, vec_float p) {
+  if (kraus.size() == 0 or kraus.size() != p.size()) {
+    sstr err;
+    err << "Arguments \'kraus\' and \'p\' must have the same size, "
+        << "greater than 0";
+    throw std::invalid_argument{err.str()};
+  }
+
+  std::vector<sp_cx_mat> e;
+  for (auto &ops : kraus) {
+    e.push_back(this->kraus(ops));
+    if (e.back().n_rows != e[0].n_rows) {
+      sstr err;
+      err << "All \'kraus\' operators must have the same size";
+      throw std::invalid_argument{err.str()};
+    }
+  }
+
+  smap[name] = superop(e, p);
+  kmap[name] = {e, p};
 }
 
 /*********************************************************/
@@ -203,6 +355,10 @@ std::string Gates::__str__() {
     out << gate.first << " - "
         << log2(gate.second.n_rows)  << " qbits long"<< std::endl;
   }
+  for (auto& channel: smap) {
+    out << channel.first << " - "
+        << log2(channel.second.n_rows)/2  << " qbits long channel"<< std::endl;
+  }
   return out.str();
 }
 
@@ -0,0 +1,74 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "../header/philox.h"
+
+/*********************************************************/
+Philox::Philox(uint64_t seed, uint64_t stream) : 
+  key{seed}, 
+  stream{stream}, 
+  count{0} 
+{}
+
+/*********************************************************/
+double Philox::uniform() {
+  return uniform(count++);
+}
+
+/*********************************************************/
+double Philox::uniform(uint64_t index) const {
+  return (bits(index) >> 11)*0x1.0p-53;
+}
+
+/*********************************************************/
+Philox Philox::split() {
+  return split(count++);
+}
+
+/*********************************************************/
+Philox Philox::split(uint64_t index) const {
+  return Philox{key, bits(index)};
+}
+
+/*********************************************************/
+uint64_t Philox::bits(uint64_t index) const {
+  uint32_t ctr[4] = {uint32_t(index), uint32_t(index >> 32), 
+                     uint32_t(stream), uint32_t(stream >> 32)};
+  uint32_t k0 = uint32_t(key), k1 = uint32_t(key >> 32);
+
+  for (int round = 0; round < 10; round++) {
+    uint64_t p0 = uint64_t(0xD2511F53)*ctr[0];
+    uint64_t p1 = uint64_t(0xCD9E8D57)*ctr[2];
+    uint32_t c1 = ctr[1], c3 = ctr[3];
+    ctr[0] = uint32_t(p1 >> 32) ^ c1 ^ k0;
+    ctr[1] = uint32_t(p1);
+    ctr[2] = uint32_t(p0 >> 32) ^ c3 ^ k1;
+    ctr[3] = uint32_t(p0);
+    k0 += 0x9E3779B9;
+    k1 += 0xBB67AE85;
+  }
+
+  return uint64_t(ctr[0]) | uint64_t(ctr[1]) << 32;
+}
@@ -0,0 +1,135 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#include "../header/pool.h"
+#include <algorithm>
+
+/*********************************************************/
+ThreadPool::ThreadPool() :
+  job{nullptr},
+  nblocks{0},
+  next{0},
+  nworkers{0},
+  running{0},
+  generation{0},
+  stop{false}
+{}
+
+/*********************************************************/
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stop = true;
+  }
+  start.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+/*********************************************************/
+ThreadPool& ThreadPool::global() {
+  static ThreadPool pool;
+  return pool;
+}
+
+/*********************************************************/
+void ThreadPool::run(size_t nthreads,
+                     size_t nblocks,
+                     const std::function<void(size_t)> &block) {
+  if (nthreads <= 1 or nblocks <= 1) {
+    for (size_t i = 0; i < nblocks; i++)
+      block(i);
+    return;
+  }
+
+  std::lock_guard<std::mutex> job_lock{job_mutex};
+
+  nthreads = std::min(nthreads, nblocks);
+  while (workers.size() < nthreads-1)
+    workers.emplace_back(&ThreadPool::work, this, workers.size());
+
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    job = &block;
+    this->nblocks = nblocks;
+    next = 0;
+    nworkers = nthreads-1;
+    running = nthreads-1;
+    error = nullptr;
+    generation++;
+  }
+  start.notify_all();
+
+  take_blocks();
+
+  /* the workers must be done with the job before it goes out of scope,
+   * even if a block has thrown */
+  std::unique_lock<std::mutex> lock{mutex};
+  done.wait(lock, [&] { return running == 0; });
+  job = nullptr;
+  if (error) 
+    std::rethrow_exception(std::exchange(error, nullptr));
+}
+
+/*********************************************************/
+void ThreadPool::take_blocks() {
+  for (;;) {
+    size_t i;
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      if (next == nblocks or error) return;
+      i = next++;
+    }
+    try {
+      (*job)(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock{mutex};
+      if (not error) 
+        error = std::current_exception();
+    }
+  }
+}
+
+/*********************************************************/
+void ThreadPool::work(size_t id) {
+  size_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock{mutex};
+      start.wait(lock, [&] {
+        return stop or (generation != seen and id < nworkers);
+      });
+      if (stop) return;
+      seen = generation;
+    }
+
+    take_blocks();
+
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      running--;
+    }
+    done.notify_one();
+  }
+}
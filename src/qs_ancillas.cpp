@@ -23,72 +23,152 @@
  */                                                                               
 
 #include "../header/qsystem.h"
+#include "../header/builder.h"
 
 using namespace arma;
 
 /******************************************************/
 void QSystem::add_ancillas(size_t nqbits) {
-  if (nqbits == 0) {
+  if (nqbits == 0) 
     throw std::invalid_argument{"\'an_num\' argument must be greater than 0"};
-  } else if (an_size != 0) {
-    sstr err;
-    err << "There are already ancillas in the system, you can not add more";
-    throw std::invalid_argument{err.str()};
-  }
 
   sync();
 
-  an_size = nqbits;
-  an_ops = new Gate_aux[an_size]();
-  an_bits = new Bit[an_size]();
-
-  sp_cx_mat an_qbits{1ul << an_size, _state == "matrix" ? 1lu << an_size : 1};
-  an_qbits(0,0) = 1;
-  qbits = kron(qbits, an_qbits);
+  /* new ancillas are stacked after the ones already in the system */
+  Gate_aux *ops = new Gate_aux[an_size+nqbits]();
+  Bit *bits = new Bit[an_size+nqbits]();
+  std::copy(an_bits, an_bits+an_size, bits);
+  delete[] an_ops;
+  delete[] an_bits;
+  an_ops = ops;
+  an_bits = bits;
+  an_size += nqbits;
+
+  bool vector = _state == "vector";
+  size_t span = 1ul << nqbits;
+
+  if (_dense) {
+    size_t dim = dqbits.n_rows;
+    size_t dimn = dim << nqbits;
+    size_t cols = vector? 1 : dimn;
+
+    if (dqbits.capacity() >= dimn*cols) {
+      /* in place: going down, every amplitude moves to an index not below
+       * its own, so the ones not moved yet are never overwritten */
+      dqbits.reshape(dimn, cols);
+      complex *amps = dqbits.memptr();
+      for (size_t col = cols; col-- > 0;) {
+        complex *dst = amps+col*dimn;
+        if (col & (span-1)) {
+          std::fill(dst, dst+dimn, complex{0});
+          continue;
+        }
+        const complex *src = amps+(col >> nqbits)*dim;
+        for (size_t row = dim; row-- > 0;) {
+          complex amp = src[row];
+          std::fill(dst+(row << nqbits), dst+((row+1) << nqbits), complex{0});
+          dst[row << nqbits] = amp;
+        }
+      }
+    } else {
+      Amplitudes qbitsm{dimn, cols, reserved(cols)};
+      complex *amps = dqbits.memptr();
+      complex *ampsm = qbitsm.memptr();
+      parallel(vector? dim : dim*dim, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) 
+          ampsm[((i%dim) << nqbits)+((i/dim) << nqbits)*dimn] = amps[i];
+      });
+      dqbits = std::move(qbitsm);
+    }
+  } else {
+    const sp_cx_mat &m = qbits;
+    SpBuilder qbitsm{m.n_rows << nqbits, vector? 1 : m.n_cols << nqbits,
+                     m.n_nonzero};
+    for (auto i = m.begin(); i != m.end(); ++i) 
+      qbitsm.set(i.row() << nqbits, i.col() << (vector? 0 : nqbits), *i);
+    qbits = qbitsm.build();
+  }
+  adapt_storage();
 }
 
 /******************************************************/
-void QSystem::rm_ancillas() {
+void QSystem::rm_ancillas(size_t count) {
   if (an_size == 0) 
     throw std::logic_error{"There are no ancillas on the system"};
-  sync();
-
-  auto tr_pure = [&]() {
-    auto sizet = 1ul << (size()-1);
-    sp_cx_mat qbitst{sizet, 1};
-
-    if (an_bits[an_size-1] == NONE) 
-      measure(_size+an_size-1);
-
-    for (auto i = qbits.begin(); i != qbits.end(); ++i) 
-      qbitst(i.row() >> 1, 0) += *i;
-
-    return qbitst;
-  };
+  if (count > an_size) {
+    sstr err;
+    err << "\'count\' argument must be at most the number of ancillas ("
+        << an_size << "), not " << count;
+    throw std::invalid_argument{err.str()};
+  }
+  if (count == 0) 
+    count = an_size;
 
-  auto tr_mix = [&]() {
-    auto sizet = 1ul << (size()-1);
-    sp_cx_mat qbitst{sizet, sizet};
+  sync();
 
-    for (auto i = qbits.begin(); i != qbits.end(); ++i) {
-      if ((i.row() % 2) == (i.col() % 2))
-        qbitst(i.row() >> 1, i.col() >> 1) += *i;
+  size_t keep = an_size-count;
+  bool vector = _state == "vector";
+
+  /* the ancillas that were not measured yet are measured together, and
+   * then all of them are traced out in a single pass */
+  if (vector and std::count(an_bits+keep, an_bits+an_size, NONE)) 
+    measure(size()-count, count);
+
+  size_t an_dim = 1ul << count;
+  size_t dimt = 1ul << (size()-count);
+
+  if (_dense) {
+    size_t dim = dqbits.n_rows;
+    complex *amps = dqbits.memptr();
+
+    /* every amplitude is written at an index not above the ones it is
+     * summed from, so going up the trace can be done in place */
+    auto trace = [&](complex *ampst, size_t begin, size_t end) {
+      if (vector) {
+        for (size_t i = begin; i < end; i++) {
+          complex sum = 0;
+          for (size_t a = 0; a < an_dim; a++)
+            sum += amps[(i << count) | a];
+          ampst[i] = sum;
+        }
+      } else {
+        for (size_t col = begin; col < end; col++) 
+          for (size_t row = 0; row < dimt; row++) {
+            complex sum = 0;
+            for (size_t a = 0; a < an_dim; a++)
+              sum += amps[((row << count) | a)+((col << count) | a)*dim];
+            ampst[row+col*dimt] = sum;
+          }
+      }
+    };
+
+    if (_reserve) {
+      trace(amps, 0, dimt);
+      dqbits.reshape(dimt, vector? 1 : dimt);
+    } else {
+      Amplitudes qbitst{dimt, vector? 1 : dimt};
+      parallel(dimt, [&](size_t begin, size_t end) {
+        trace(qbitst.memptr(), begin, end);
+      });
+      dqbits = std::move(qbitst);
     }
-
-    return qbitst;
-  };
-
-  while (an_size) {
-    if (_state == "vector")
-      qbits = tr_pure();
-    else if (_state == "matrix")
-      qbits = tr_mix();
-    an_size--;
+  } else {
+    const sp_cx_mat &m = qbits;
+    SpBuilder qbitst{dimt, vector? 1 : dimt, m.n_nonzero};
+    for (auto i = m.begin(); i != m.end(); ++i) 
+      if (vector or ((i.row() ^ i.col()) & (an_dim-1)) == 0)
+        qbitst.set(i.row() >> count, i.col() >> count, *i);
+    qbits = qbitst.build(true);
   }
 
+  Gate_aux *ops = keep? new Gate_aux[keep]() : nullptr;
+  Bit *bits = keep? new Bit[keep]() : nullptr;
+  std::copy(an_bits, an_bits+keep, bits);
   delete[] an_ops;
-  an_ops = nullptr;
   delete[] an_bits;
-  an_bits = nullptr;
-}
+  an_ops = ops;
+  an_bits = bits;
+  an_size = keep;
 
+  adapt_storage();
+}
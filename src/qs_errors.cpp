@@ -33,69 +33,173 @@ void QSystem::flip(char gate, size_t qbit, double p) {
   valid_p(p);
 
   if (_state == "vector") {
-    if (auto pr = double(std::rand())/double(RAND_MAX); p != 0 and pr <= p) 
+    if (auto pr = _rng.uniform(); p != 0 and pr < p) 
       evol(std::string{gate}, qbit);
 
   } else if (_state == "matrix") {
     sync();
-    sp_cx_mat E0 = make_gate(gates.get(gate), qbit)*sqrt(p);
-
-    size_t eyesize = 1ul << size();
-    sp_cx_mat E1 = eye<sp_cx_mat>(eyesize, eyesize)*sqrt(1.f-p);
-
-    qbits = E0*qbits*E0.t() + E1*qbits*E1;
+    apply_kraus(qbit, Gates::superop({gates.get(gate)}, {p}, 1-p));
   }
 }
 
 /******************************************************/
 void QSystem::amp_damping(size_t qbit, double p) {
-  valid_state();
   valid_qbit("qbit", qbit);
   valid_p(p);
 
   sync();
 
-  sp_cx_mat E0 = make_gate(sp_cx_mat{cx_mat{{{{1, 0}, {0, 0}},
-                                             {{0, 0}, {sqrt(1-p), 0}}}}}, qbit);
-  sp_cx_mat E1 = make_gate(sp_cx_mat{cx_mat{{{{0, 0}, {sqrt(p), 0}},
-                                             {{0, 0}, {0, 0}}}}}, qbit);
-  qbits = E0*qbits*E0 + E1*qbits*E1.t();
+  if (_state == "vector")
+    apply_jump(qbit, Gates::amp_damping(p), {1, 1});
+  else 
+    apply_kraus(qbit, Gates::superop(Gates::amp_damping(p), {1, 1}));
 }
 
 /******************************************************/
 void QSystem::dpl_channel(size_t qbit, double p) {
-  valid_state();
   valid_qbit("qbit", qbit);
   valid_p(p);
 
   sync();
 
-  sp_cx_mat X = make_gate(gates.get('X'), qbit);
-  sp_cx_mat Y = make_gate(gates.get('Y'), qbit);
-  sp_cx_mat Z = make_gate(gates.get('Z'), qbit);
-  
-  qbits = (1-p)*qbits+(p/3)*(X*qbits*X+Y*qbits*Y.t()+Z*qbits*Z);
+  if (_state == "vector") {
+    apply_jump(qbit, {gates.get('I'), gates.get('X'), 
+                      gates.get('Y'), gates.get('Z')}, 
+                     {1-p, p/3, p/3, p/3});
+    return;
+  }
+
+  apply_kraus(qbit, Gates::superop({gates.get('X'), 
+                                    gates.get('Y'),
+                                    gates.get('Z')}, {p/3, p/3, p/3}, 1-p));
 }
 
 /******************************************************/
 void QSystem::sum(size_t qbit, vec_str kraus, vec_float p) {
-  valid_state();
   valid_qbit("qbit", qbit);
-  valid_krau(kraus);
+
+  std::vector<sp_cx_mat> E;
+  for (auto &ops : kraus) 
+    E.push_back(gates.kraus(ops));
+
+  valid_krau(E, p);
+  valid_count(qbit, 1, log2(E[0].n_rows));
     
   sync();
 
-  sp_cx_mat qbits_tmp{qbits.n_rows, qbits.n_cols};
+  if (_state == "vector")
+    apply_jump(qbit, E, p);
+  else 
+    apply_kraus(qbit, Gates::superop(E, p));
+}
 
-  for (size_t i = 0; i < kraus.size(); ++i) {
-    sp_cx_mat E = gates.get(kraus[i][0]);
-    for (size_t j = 1; j < kraus[i].size(); ++j)
-      E = kron(E, gates.get(kraus[i][j]));
-    E = make_gate(E, qbit);
-    
-    qbits_tmp +=  p[i]*(E*qbits*E.t());
+/******************************************************/
+void QSystem::channel(std::string name, size_t qbit) {
+  valid_qbit("qbit", qbit);
+  sp_cx_mat &super = gates.channel(name);
+  valid_count(qbit, 1, log2(super.n_rows)/2);
+
+  sync();
+
+  if (_state == "vector") {
+    auto &kraus = gates.channel_kraus(name);
+    apply_jump(qbit, kraus.first, kraus.second);
+  } else {
+    apply_kraus(qbit, super);
   }
+}
 
-  qbits = qbits_tmp;  
+/******************************************************/
+void QSystem::apply_kraus(size_t qbit, const sp_cx_mat &super) {
+  /* the channel is applied as a single local superoperator over the column
+   * and row qubits of rho */
+  vec_size_t qbits;
+  for (size_t i = 0; i < log2(super.n_rows)/2; i++)
+    qbits.push_back(qbit+i);
+  if (sparse_fits(super, true)) {
+    apply_sparse_super(qbits, super);
+  } else {
+    to_dense();
+    apply_super(dqbits.memptr(), qbits, super);
+  }
+
+  adapt_storage();
 }
 
+/******************************************************/
+void QSystem::apply_jump(size_t qbit,
+                   const std::vector<sp_cx_mat> &kraus,
+                   const vec_float &p) {
+  size_t size_n = log2(kraus[0].n_rows);
+  size_t dim_n = 1ul << size_n;
+  size_t dim = 1ul << size();
+  size_t low = size()-qbit-size_n;
+  size_t local = (dim_n-1) << low;
+
+  /* the weight of E_k is p_k <psi|E_k^dagger E_k|psi>, that does not need
+   * a pass over the state if E_k^dagger E_k is proportional to I, like for
+   * the Pauli operators */
+  vec_float w(kraus.size());
+  for (size_t k = 0; k < kraus.size(); k++) {
+    cx_mat e{kraus[k]};
+    cx_mat m{dim_n, dim_n};
+    m.zeros();
+    bool scalar = true;
+    for (size_t a = 0; a < dim_n; a++)
+      for (size_t b = 0; b < dim_n; b++) {
+        for (size_t c = 0; c < dim_n; c++)
+          m(a, b) += std::conj(e(c, a))*e(c, b);
+        if (a == b? m(a, b) != m(0, 0) : m(a, b) != 0.0) 
+          scalar = false;
+      }
+
+    if (p[k] == 0) {
+      w[k] = 0;
+    } else if (scalar) {
+      w[k] = p[k]*m(0, 0).real();
+    } else if (_dense) {
+      complex *amps = dqbits.memptr();
+      w[k] = p[k]*parallel_sum(dim >> size_n, [&](size_t begin, size_t end) {
+        double sum = 0;
+        for (size_t r = begin; r < end; r++) {
+          size_t i = ((r << size_n) & ~((1ul << (low+size_n))-1)) 
+                   | (r & ((1ul << low)-1));
+          for (size_t a = 0; a < dim_n; a++)
+            for (size_t b = 0; b < dim_n; b++)
+              sum += (std::conj(amps[i | (a << low)])*m(a, b)
+                      *amps[i | (b << low)]).real();
+        }
+        return sum;
+      });
+    } else {
+      const sp_cx_mat &q = qbits;
+      double sum = 0;
+      for (auto i = q.begin(); i != q.end(); ++i) {
+        size_t a = (i.row() & local) >> low;
+        for (size_t b = 0; b < dim_n; b++) 
+          if (m(a, b) != 0.0)
+            sum += (std::conj((complex) *i)*m(a, b)
+                    *q((i.row() & ~local) | (b << low), 0)).real();
+      }
+      w[k] = p[k]*sum;
+    }
+  }
+
+  double total = 0;
+  for (auto &i : w)
+    total += i;
+
+  size_t k = 0;
+  double r = _rng.uniform()*total, acc = w[0];
+  while (k+1 < w.size() and (r >= acc or w[k] == 0)) 
+    acc += w[++k];
+  /* rounding can leave the draw past the end */
+  while (k > 0 and w[k] == 0)
+    k--;
+  if (w[k] == 0) 
+    return;
+
+  /* E_k/||E_k psi|| keeps the state normalized */
+  cx_mat e{kraus[k]};
+  fill(Gate_aux::MATRIX, qbit, size_n, sp_cx_mat{e*sqrt(p[k]/w[k])});
+}
@@ -27,6 +27,22 @@
 
 using namespace arma;
 
+/* diagonal operators acting on the same qubits are multiplied together */
+static void add_term(std::vector<diag_term> &terms, diag_term term) {
+  for (auto &[qbits, d] : terms) {
+    if (qbits == term.first) {
+      for (size_t i = 0; i < d.size(); i++)
+        d[i] *= term.second[i];
+      return;
+    }
+  }
+  terms.push_back(term);
+}
+
+/* pending operators of up to this many qubits absorb the gates applied next
+ * to them, so that they all are applied in a single pass over the state */
+static const size_t fuse_size = 4;
+
 /******************************************************/
 void QSystem::evol(std::string gate,
                         size_t qbit, 
@@ -37,24 +53,13 @@ void QSystem::evol(std::string gate,
   if (gate.size() > 1) {
     auto size_n = log2(gates.mget(gate).n_rows);
     valid_count(qbit, count, size_n);
-    sync(qbit, qbit+count*size_n);
-    for (size_t i = 0; i < count; i++) {
-      size_t index = qbit+i*gate.size();
-      fill(Gate_aux::GATE_N, index, size_n);
-      ops(index).data = gate;
-      ops(index).inver = inver;
-    }
+    for (size_t i = 0; i < count; i++) 
+      fill(Gate_aux::GATE_N, qbit+i*size_n, size_n, gate, inver);
   } else {
     valid_count(qbit, count);
-    sync(qbit, qbit+count);
-    for (size_t i = 0; i < count; i++) {
-      ops(qbit+i).tag = Gate_aux::GATE_1;
-      ops(qbit+i).data = gate[0];
-      ops(qbit+i).inver = inver;
-    }
+    for (size_t i = 0; i < count; i++) 
+      fuse(qbit+i, gate[0], inver);
   }
-
-  _sync = false;
 }
 
 /******************************************************/
@@ -63,8 +68,7 @@ void QSystem::cnot(size_t target, vec_size_t control) {
   valid_control(control);
 
   auto [size_n, minq] = cut(target, control);
-  fill(Gate_aux::CNOT, minq, size_n);
-  ops(minq).data = cnot_pair{target, control};
+  fill(Gate_aux::CNOT, minq, size_n, cnot_pair{target, control});
 }
 
 /******************************************************/
@@ -74,8 +78,69 @@ void QSystem::cphase(complex phase, size_t target, vec_size_t control) {
   valid_control(control);
 
   auto [size_n, minq] = cut(target, control);
-  fill(Gate_aux::CPHASE, minq, size_n);
-  ops(minq).data = cph_tuple{phase, target, control};
+  fill(Gate_aux::CPHASE, minq, size_n, cph_tuple{phase, target, control});
+}
+
+/******************************************************/
+void QSystem::controlled(std::string gate,
+                              size_t target,
+                          vec_size_t control,
+                                bool inver) {
+  valid_qbit("target", target);
+
+  size_t size_n = gate.size() == 1? log2(gates.get(gate[0]).n_rows)
+                                  : log2(gates.mget(gate).n_rows);
+  valid_count(target, 1, size_n);
+
+  vec_size_t targets;
+  for (size_t i = 0; i < size_n; i++)
+    targets.push_back(target+i);
+
+  controlled(gate, targets, control, inver);
+}
+
+/******************************************************/
+void QSystem::controlled(std::string gate,
+                          vec_size_t targets,
+                          vec_size_t control,
+                                bool inver) {
+  valid_control(control);
+  valid_targets(gate, targets, control);
+  fill_list(gate, targets, control, inver);
+}
+
+/******************************************************/
+void QSystem::evol(std::string gate, vec_size_t qbits, bool inver) {
+  vec_size_t control;
+  valid_targets(gate, qbits, control);
+
+  bool contiguous = true;
+  for (size_t i = 1; i < qbits.size(); i++)
+    contiguous = contiguous and qbits[i] == qbits[0]+i;
+
+  if (contiguous) 
+    evol(gate, qbits[0], 1, inver);
+  else
+    fill_list(gate, qbits, control, inver);
+}
+
+/******************************************************/
+void QSystem::fill_list(std::string gate,
+                         vec_size_t targets,
+                         vec_size_t control,
+                               bool inver) {
+  vec_size_t qbits = targets;
+  qbits.insert(qbits.end(), control.begin(), control.end());
+  size_t minq = *std::min_element(qbits.begin(), qbits.end());
+  size_t maxq = *std::max_element(qbits.begin(), qbits.end());
+
+  for (auto &i : targets)
+    i -= minq;
+  for (auto &i : control)
+    i -= minq;
+
+  fill(Gate_aux::CONTROLLED, minq, maxq-minq+1,
+       ctrl_tuple{gate, targets, control}, inver);
 }
 
 /******************************************************/
@@ -92,26 +157,98 @@ void QSystem::swap(size_t qbit_a, size_t qbit_b) {
 void QSystem::qft(size_t qbegin, size_t qend, bool inver) {
   valid_range(qbegin, qend);
 
-  fill(Gate_aux::QFT, qbegin, qend-qbegin);
-  ops(qbegin).inver = inver;
+  fill(Gate_aux::QFT, qbegin, qend-qbegin, 'I', inver);
+}
+
+/******************************************************/
+void QSystem::run(Circuit &circuit, vec_float params) {
+  valid_circuit(circuit, params);
+
+  for (auto &op : circuit.ops) {
+    double angle = op.scale*(op.kind == Circuit::Op::ROT 
+                             or op.kind == Circuit::Op::PHASE? 
+                             params[op.param] : 0);
+    switch (op.kind) {
+    case Circuit::Op::GATE_1:
+      fuse(op.qbit, op.gate[0], op.inver);
+      break;
+    case Circuit::Op::GATE_N:
+      fill(Gate_aux::GATE_N, op.qbit, op.size, op.gate, op.inver);
+      break;
+    case Circuit::Op::CNOT:
+      fill(Gate_aux::CNOT, op.qbit, op.size, cnot_pair{op.target, op.control});
+      break;
+    case Circuit::Op::CPHASE:
+      fill(Gate_aux::CPHASE, op.qbit, op.size,
+           cph_tuple{op.phase, op.target, op.control});
+      break;
+    case Circuit::Op::CONTROLLED:
+      fill(Gate_aux::CONTROLLED, op.qbit, op.size,
+           ctrl_tuple{op.gate, op.targets, op.control}, op.inver);
+      break;
+    case Circuit::Op::QFT:
+      fill(Gate_aux::QFT, op.qbit, op.size, 'I', op.inver);
+      break;
+    case Circuit::Op::SWAP:
+      fill(Gate_aux::SWAP, op.qbit, op.size);
+      break;
+    case Circuit::Op::ROT: {
+      double c = cos(angle/2), s = sin(angle/2);
+      if (op.axis == 'Z') 
+        fill(Gate_aux::DIAG, op.qbit, 1, std::vector<diag_term>{
+             {{0}, {std::polar(1.0, -angle/2), std::polar(1.0, angle/2)}}});
+      else if (op.axis == 'X') 
+        fill(Gate_aux::MATRIX, op.qbit, 1, 
+             sp_cx_mat{cx_mat{{{c, 0}, {0, -s}}, {{0, -s}, {c, 0}}}});
+      else 
+        fill(Gate_aux::MATRIX, op.qbit, 1, 
+             sp_cx_mat{cx_mat{{{c, 0}, {-s, 0}}, {{s, 0}, {c, 0}}}});
+      break;
+    }
+    case Circuit::Op::PHASE:
+      if (op.control.empty()) 
+        fill(Gate_aux::DIAG, op.qbit, 1, std::vector<diag_term>{
+             {{0}, {1, std::polar(1.0, angle)}}});
+      else
+        fill(Gate_aux::CPHASE, op.qbit, op.size,
+             cph_tuple{std::polar(1.0, angle), op.target, op.control});
+      break;
+    case Circuit::Op::MEASURE:
+      measure(op.qbit, op.size);
+      break;
+    case Circuit::Op::NOISE:
+      sync();
+      if (_state == "vector") 
+        apply_jump(op.qbit, op.kraus, op.p);
+      else 
+        apply_kraus(op.qbit, op.super);
+      break;
+    }
+  }
 }
 
 /******************************************************/
 void QSystem::sync() {
   if (_sync) return;
 
-  sp_cx_mat evolm;
-  
-  evolm = get_gate(ops(0));
-
-  for (size_t i = ops(0).size; i < size(); i += ops(i).size) {
-    evolm = kron(evolm, get_gate(ops(i)));
+  /* a sparse state stays sparse while the gates keep it under the dense
+   * fill, see sparse_fits */
+  std::vector<diag_term> diag;
+  for (size_t i = 0; i < size(); i += ops(i).size) {
+    if (not ops(i).busy() or diagonal(ops(i), i, diag)) 
+      continue;
+    if (_dense)
+      apply_op(ops(i), i);
+    else
+      apply_sparse_op(ops(i), i);
   }
 
-  if (_state == "vector")
-    qbits = evolm*qbits;
-  else if (_state == "matrix")
-    qbits = evolm*qbits*evolm.t();
+  if (not diag.empty() and _dense)
+    apply_diag(dqbits.memptr(), diag);
+  else if (not diag.empty())
+    apply_sparse_diag(diag);
+
+  adapt_storage();
 
   delete[] _ops;
   _ops = new Gate_aux[_size]();
@@ -158,15 +295,78 @@ sp_cx_mat QSystem::get_gate(Gate_aux &op) {
                            op.size);
       case Gate_aux::SWAP:
         return make_swap(op.size);
+      case Gate_aux::MATRIX:
+        return std::get<sp_cx_mat>(op.data);
+      case Gate_aux::DIAG:
+        return make_diag(std::get<std::vector<diag_term>>(op.data), op.size);
+      case Gate_aux::CONTROLLED: {
+        auto &[gate, targets, control] = std::get<ctrl_tuple>(op.data);
+        return make_controlled(gate.size() == 1? gates.get(gate[0])
+                                               : gates.mget(gate),
+                               targets, control, op.size);
+      }
       default:
         return make_qft(op.size);
       }
   };
 
-  if (op.inver) 
-    return get().t();
-  else 
-    return get();
+  std::string key = op_key(op);
+  if (not key.empty()) {
+    auto cached = _cache_map.find(key);
+    if (cached != _cache_map.end()) {
+      _cache.splice(_cache.begin(), _cache, cached->second);
+      return cached->second->second;
+    }
+  }
+
+  sp_cx_mat m = op.inver? sp_cx_mat{get().t()} : get();
+  if (not key.empty())
+    cache_put(key, m);
+  return m;
+}
+
+/******************************************************/
+std::string QSystem::op_key(Gate_aux &op) {
+  /* just the operators built from the op itself are cached, the ones from
+   * Gates can change if the user creates a gate with the same name */
+  sstr key;
+  key << op.tag << ' ' << op.size << ' ' << op.inver << ' ';
+  switch (op.tag) {
+  case Gate_aux::CNOT: {
+    auto &[target, control] = std::get<cnot_pair>(op.data);
+    key << target;
+    for (auto i : control)
+      key << ' ' << i;
+    break;
+  }
+  case Gate_aux::CPHASE: {
+    auto &[phase, target, control] = std::get<cph_tuple>(op.data);
+    key << std::hexfloat << phase.real() << ' ' << phase.imag() << ' ' 
+        << std::dec << target;
+    for (auto i : control)
+      key << ' ' << i;
+    break;
+  }
+  case Gate_aux::SWAP:
+  case Gate_aux::QFT:
+    break;
+  default:
+    return "";
+  }
+  return key.str();
+}
+
+/******************************************************/
+void QSystem::cache_put(std::string key, const sp_cx_mat &m) {
+  size_t nbytes = m.n_nonzero*(sizeof(complex)+sizeof(uword))
+                + (m.n_cols+1)*sizeof(uword);
+  if (nbytes > _cache_max) return;
+
+  _cache.push_front({key, m});
+  _cache_map[key] = _cache.begin();
+  _cache_bytes += nbytes;
+
+  set_cache(_cache_max);
 }
 
 /******************************************************/
@@ -185,15 +385,421 @@ cut_pair QSystem::cut(size_t &target, vec_size_t &control) {
 }
 
 /******************************************************/
-void QSystem::fill(Gate_aux::Tag tag, size_t qbit, size_t size_n) {
-  sync(qbit, qbit+size_n);
+void QSystem::fill(Gate_aux::Tag tag,
+                          size_t qbit,
+                          size_t size_n,
+               Gate_aux::op_data data,
+                            bool inver) {
+  Gate_aux op;
+  op.tag = tag;
+  op.size = size_n;
+  op.data = data;
+  op.inver = inver;
 
-  ops(qbit).tag = tag;
-  ops(qbit).size = size_n;
- 
-  for (size_t i = qbit+1; i < qbit+size_n; i++)
+  std::vector<diag_term> terms;
+  if (diagonal(op, qbit, terms) and merge_diag(qbit, size_n, terms))
+    return;
+
+  sp_cx_mat before;
+  bool fused = size_n <= fuse_size and fusable(op) 
+               and pending(qbit, size_n, before);
+  if (not fused)
+    sync(qbit, qbit+size_n);
+
+  place(tag, qbit, size_n, data, inver);
+
+  if (fused) 
+    place(Gate_aux::MATRIX, qbit, size_n, get_gate(ops(qbit))*before, false);
+}
+
+/******************************************************/
+void QSystem::fuse(size_t qbit, char gate, bool inver) {
+  if (not ops(qbit).busy()) {
+    place(Gate_aux::GATE_1, qbit, 1, gate, inver);
+    return;
+  }
+
+  if (gate == 'I') return;
+
+  Gate_aux op;
+  op.data = gate;
+  op.inver = inver;
+
+  std::vector<diag_term> terms;
+  if (diagonal(op, qbit, terms) and merge_diag(qbit, 1, terms))
+    return;
+
+  size_t begin = op_begin(qbit);
+  size_t size_n = ops(begin).size;
+  if (size_n > fuse_size or not fusable(ops(begin))) {
+    sync();
+    place(Gate_aux::GATE_1, qbit, 1, gate, inver);
+    return;
+  }
+
+  sp_cx_mat u = inver? gates.get(gate).t() : gates.get(gate);
+  u = kron(kron(eye<sp_cx_mat>(1ul << (qbit-begin), 1ul << (qbit-begin)), u),
+           eye<sp_cx_mat>(1ul << (begin+size_n-qbit-1),
+                          1ul << (begin+size_n-qbit-1)));
+
+  place(Gate_aux::MATRIX, begin, size_n, u*get_gate(ops(begin)), false);
+}
+
+/******************************************************/
+size_t QSystem::op_begin(size_t qbit) {
+  size_t i = 0;
+  while (i+ops(i).size <= qbit)
+    i += ops(i).size;
+  return i;
+}
+
+/******************************************************/
+bool QSystem::pending(size_t qbit, size_t size_n, sp_cx_mat &m) {
+  if (op_begin(qbit) != qbit) return false;
+
+  bool busy = false;
+  m = eye<sp_cx_mat>(1, 1);
+  for (size_t i = qbit; i < qbit+size_n; i += ops(i).size) {
+    if (i+ops(i).size > qbit+size_n) return false;
+    if (ops(i).busy() and not fusable(ops(i))) return false;
+    if (ops(i).busy()) {
+      m = kron(m, get_gate(ops(i)));
+      busy = true;
+    } else {
+      m = kron(m, eye<sp_cx_mat>(2, 2));
+    }
+  }
+
+  return busy;
+}
+
+/******************************************************/
+bool QSystem::fusable(Gate_aux &op) {
+  /* the ops with a kernel faster than a local matrix, like permutations,
+   * controlled gates and the QFT, are not merged with others */
+  switch (op.tag) {
+  case Gate_aux::GATE_1:
+  case Gate_aux::MATRIX:
+    return true;
+  case Gate_aux::GATE_N: {
+    auto &gate = std::get<std::string>(op.data);
+    return gates.mpermutation(gate).empty() and gates.mcontrol(gate) == 0;
+  }
+  default:
+    return false;
+  }
+}
+
+/******************************************************/
+void QSystem::place(Gate_aux::Tag tag,
+                           size_t qbit,
+                           size_t size_n,
+                Gate_aux::op_data data,
+                             bool inver) {
+  for (size_t i = qbit; i < qbit+size_n; i++) {
+    ops(i) = Gate_aux{};
     ops(i).tag = tag;
+  }
+
+  ops(qbit).size = size_n;
+  ops(qbit).data = data;
+  ops(qbit).inver = inver;
 
   _sync = false;
 }
 
+
+/******************************************************/
+bool QSystem::diagonal(Gate_aux &op,
+                          size_t qbit,
+          std::vector<diag_term> &terms) {
+  auto add = [&](vec_size_t qbits, vec_complex d) {
+    if (op.inver) 
+      for (auto &i : d) i = std::conj(i);
+    add_term(terms, diag_term{qbits, d});
+  };
+
+  switch (op.tag) {
+  case Gate_aux::GATE_1: {
+    char gate = std::get<char>(op.data);
+    if (not gates.diagonal(gate)) return false;
+    const sp_cx_mat &u = gates.get(gate);
+    add({qbit}, {u(0, 0), u(1, 1)});
+    return true;
+  }
+  case Gate_aux::GATE_N: {
+    auto &gate = std::get<std::string>(op.data);
+    if (not gates.mdiagonal(gate)) return false;
+    const sp_cx_mat &u = gates.mget(gate);
+    vec_size_t qbits;
+    vec_complex d;
+    for (size_t i = 0; i < op.size; i++)
+      qbits.push_back(qbit+i);
+    for (size_t i = 0; i < u.n_rows; i++)
+      d.push_back(u(i, i));
+    add(qbits, d);
+    return true;
+  }
+  case Gate_aux::CPHASE: {
+    auto [phase, target, control] = std::get<cph_tuple>(op.data);
+    vec_size_t qbits{target+qbit};
+    for (auto i : control) 
+      qbits.push_back(i+qbit);
+    std::sort(qbits.begin(), qbits.end());
+    qbits.erase(std::unique(qbits.begin(), qbits.end()), qbits.end());
+    vec_complex d(1ul << qbits.size(), 1);
+    d.back() = phase;
+    add(qbits, d);
+    return true;
+  }
+  case Gate_aux::CONTROLLED: {
+    auto &[gate, targets, control] = std::get<ctrl_tuple>(op.data);
+    if (not (gate.size() == 1? gates.diagonal(gate[0])
+                             : gates.mdiagonal(gate))) 
+      return false;
+
+    const sp_cx_mat &u = gate.size() == 1? gates.get(gate[0]) 
+                                         : gates.mget(gate);
+
+    vec_size_t qbits = targets;
+    qbits.insert(qbits.end(), control.begin(), control.end());
+    std::sort(qbits.begin(), qbits.end());
+    qbits.erase(std::unique(qbits.begin(), qbits.end()), qbits.end());
+
+    vec_complex d(1ul << qbits.size());
+    for (size_t i = 0; i < d.size(); i++) {
+      bool on = true;
+      size_t local = 0;
+      for (size_t k = 0; k < qbits.size(); k++) {
+        size_t bit = (i >> (qbits.size()-k-1)) & 1;
+        auto t = std::find(targets.begin(), targets.end(), qbits[k]);
+        if (t != targets.end())
+          local |= bit << (targets.end()-t-1);
+        else
+          on = on and bit;
+      }
+      d[i] = on? u(local, local) : 1.0;
+    }
+    for (auto &i : qbits)
+      i += qbit;
+    add(qbits, d);
+    return true;
+  }
+  case Gate_aux::DIAG: 
+    for (auto term : std::get<std::vector<diag_term>>(op.data)) {
+      for (auto &i : term.first)
+        i += qbit;
+      add(term.first, term.second);
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+/******************************************************/
+bool QSystem::merge_diag(size_t qbit,
+                         size_t size_n,
+         std::vector<diag_term> terms) {
+  size_t begin = op_begin(qbit);
+  size_t end = begin;
+  std::vector<diag_term> merged;
+  while (end < qbit+size_n) {
+    if (ops(end).busy() and not diagonal(ops(end), end, merged))
+      return false;
+    end += ops(end).size;
+  }
+
+  for (auto &term : terms)
+    add_term(merged, term);
+  for (auto &term : merged)
+    for (auto &i : term.first)
+      i -= begin;
+
+  place(Gate_aux::DIAG, begin, end-begin, merged, false);
+  return true;
+}
+
+/******************************************************/
+bool QSystem::permute(Gate_aux &op, size_t qbit) {
+  auto mask = [&](size_t q) { return 1ul << (size()-q-1); };
+
+  switch (op.tag) {
+  case Gate_aux::GATE_1: 
+    return permute(std::string{std::get<char>(op.data)}, {qbit}, op.inver, 0);
+  case Gate_aux::GATE_N: {
+    vec_size_t qbits;
+    for (size_t i = 0; i < op.size; i++)
+      qbits.push_back(qbit+i);
+    return permute(std::get<std::string>(op.data), qbits, op.inver, 0);
+  }
+  case Gate_aux::CONTROLLED: {
+    auto [gate, targets, control] = std::get<ctrl_tuple>(op.data);
+    size_t cmask = 0;
+    for (auto i : control)
+      cmask |= mask(qbit+i);
+    for (auto &i : targets)
+      i += qbit;
+    return permute(gate, targets, op.inver, cmask);
+  }
+  case Gate_aux::CNOT: {
+    auto &[target, control] = std::get<cnot_pair>(op.data);
+    size_t cmask = 0;
+    for (auto i : control)
+      cmask |= mask(qbit+i);
+    if (cmask & mask(qbit+target)) return false;
+    apply_cnot(dqbits.memptr(), cmask, mask(qbit+target));
+    return true;
+  }
+  case Gate_aux::SWAP:
+    apply_swap(dqbits.memptr(), mask(qbit), mask(qbit+op.size-1));
+    return true;
+  default:
+    return false;
+  }
+}
+
+/******************************************************/
+bool QSystem::permute(std::string gate,
+               const vec_size_t &qbits,
+                             bool inver,
+                           size_t control) {
+  vec_size_t perm_1;
+  if (gate.size() == 1)
+    perm_1 = gates.permutation(gate[0]);
+  const vec_size_t &perm = gate.size() == 1? perm_1 : gates.mpermutation(gate);
+  if (perm.empty()) return false;
+
+  size_t size_n = qbits.size();
+  control |= op_control(gate, qbits);
+  size_t local = 0;
+  for (size_t k = 0; k < size_n; k++)
+    if (control & (1ul << (size()-qbits[k]-1))) 
+      local |= 1ul << (size_n-k-1);
+
+  if (size_n-__builtin_popcountl(local) == 1 and perm[local] != local) {
+    size_t target = qbits[size_n-__builtin_ctzl(~local)-1];
+    apply_cnot(dqbits.memptr(), control, 1ul << (size()-target-1));
+  } else if (inver) {
+    vec_size_t inv(perm.size());
+    for (size_t i = 0; i < perm.size(); i++)
+      inv[perm[i]] = i;
+    apply_perm(dqbits.memptr(), qbits, inv, control);
+  } else {
+    apply_perm(dqbits.memptr(), qbits, perm, control);
+  }
+  return true;
+}
+
+/******************************************************/
+size_t QSystem::op_control(std::string gate, const vec_size_t &qbits) {
+  if (gate.size() == 1) return 0;
+
+  size_t local = gates.mcontrol(gate);
+  size_t control = 0;
+  for (size_t k = 0; k < qbits.size(); k++)
+    if (local & (1ul << (qbits.size()-k-1)))
+      control |= 1ul << (size()-qbits[k]-1);
+  return control;
+}
+
+/******************************************************/
+void QSystem::apply_op(Gate_aux &op, size_t qbit) {
+  if (permute(op, qbit)) return;
+
+  switch (op.tag) {
+  case Gate_aux::GATE_N: {
+    vec_size_t qbits;
+    for (size_t i = 0; i < op.size; i++)
+      qbits.push_back(qbit+i);
+    apply_gate(dqbits.memptr(), qbits, get_gate(op),
+               op_control(std::get<std::string>(op.data), qbits));
+    break;
+  }
+  case Gate_aux::CONTROLLED: {
+    auto [gate, targets, control] = std::get<ctrl_tuple>(op.data);
+    size_t cmask = 0;
+    for (auto i : control)
+      cmask |= 1ul << (size()-qbit-i-1);
+    for (auto &i : targets)
+      i += qbit;
+    sp_cx_mat u = gate.size() == 1? gates.get(gate[0]) : gates.mget(gate);
+    if (op.inver) u = u.t();
+    apply_gate(dqbits.memptr(), targets, u, cmask | op_control(gate, targets));
+    break;
+  }
+  case Gate_aux::QFT:
+    apply_qft(dqbits.memptr(), qbit, op.size, op.inver);
+    break;
+  default:
+    apply_gate(dqbits.memptr(), qbit, get_gate(op));
+  }
+}
+
+/******************************************************/
+void QSystem::apply_sparse_op(Gate_aux &op, size_t qbit) {
+  auto mask = [&](size_t q) { return 1ul << (size()-q-1); };
+
+  vec_size_t targets;
+  for (size_t i = 0; i < op.size; i++)
+    targets.push_back(qbit+i);
+  size_t control = 0;
+  sp_cx_mat u;
+
+  switch (op.tag) {
+  case Gate_aux::GATE_N:
+    control = op_control(std::get<std::string>(op.data), targets);
+    u = get_gate(op);
+    break;
+  case Gate_aux::CONTROLLED: {
+    auto [gate, ctargets, ccontrol] = std::get<ctrl_tuple>(op.data);
+    targets.clear();
+    for (auto i : ctargets)
+      targets.push_back(qbit+i);
+    for (auto i : ccontrol)
+      control |= mask(qbit+i);
+    control |= op_control(gate, targets);
+    u = gate.size() == 1? gates.get(gate[0]) : gates.mget(gate);
+    if (op.inver) u = u.t();
+    break;
+  }
+  case Gate_aux::CNOT: {
+    /* only the target is visited, as in permute */
+    auto &[target, ccontrol] = std::get<cnot_pair>(op.data);
+    for (auto i : ccontrol)
+      control |= mask(qbit+i);
+    if (control & mask(qbit+target)) {
+      control = 0;
+      u = get_gate(op);
+    } else {
+      targets = {qbit+target};
+      u = make_cnot(0, {}, 1);
+    }
+    break;
+  }
+  case Gate_aux::SWAP:
+    targets = {qbit, qbit+op.size-1};
+    u = make_swap(2);
+    break;
+  case Gate_aux::QFT: {
+    /* checked before making the gate, that has 4^size_n elements */
+    size_t growth = 1ul << op.size;
+    if (not sparse_fits(_state == "vector"? growth : growth*growth)) {
+      to_dense();
+      apply_op(op, qbit);
+      return;
+    }
+    u = get_gate(op);
+    break;
+  }
+  default:
+    u = get_gate(op);
+  }
+
+  if (sparse_fits(u)) {
+    apply_sparse(targets, u, control);
+  } else {
+    to_dense();
+    apply_op(op, qbit);
+  }
+}
@@ -0,0 +1,613 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#include "../header/qsystem.h"
+#include "../header/simd.h"
+#include "../header/pool.h"
+#include "../header/builder.h"
+#include <algorithm>
+
+using namespace arma;
+
+/* work is split in blocks of fixed size, so that reductions add the
+ * partial results in the same order for any number of threads */
+static const size_t block_size = 1ul << 14;
+
+/******************************************************/
+static size_t deposit(size_t k, size_t mask) {
+  for (; mask; mask &= mask-1) {
+    size_t low = (mask & -mask)-1;
+    k = ((k & ~low) << 1) | (k & low);
+  }
+  return k;
+}
+
+/******************************************************/
+static size_t pext(size_t i, size_t mask) {
+  size_t r = 0;
+  for (size_t b = 1; mask; b <<= 1, mask &= mask-1)
+    if (i & mask & -mask) r |= b;
+  return r;
+}
+
+/******************************************************/
+static vec_size_t to_strides(const vec_size_t &qbits, size_t size, size_t shift) {
+  vec_size_t strides;
+  for (auto q : qbits)
+    strides.push_back(1ul << (size-q-1+shift));
+  return strides;
+}
+
+/******************************************************/
+static vec_size_t offsets(const vec_size_t &strides) {
+  size_t size_n = strides.size();
+  vec_size_t offset(1ul << size_n);
+  for (size_t l = 0; l < offset.size(); l++) 
+    for (size_t k = 0; k < size_n; k++) 
+      if (l & (1ul << (size_n-k-1))) offset[l] += strides[k];
+  return offset;
+}
+
+/******************************************************/
+static size_t local_control(const vec_size_t &strides, size_t control) {
+  size_t size_n = strides.size();
+  size_t local = 0;
+  for (size_t k = 0; k < size_n; k++)
+    if (control & strides[k]) local |= 1ul << (size_n-k-1);
+  return local;
+}
+
+/******************************************************/
+void QSystem::apply_gate(complex *amps,
+                          size_t qbit,
+                 const sp_cx_mat &gate,
+                          size_t control) {
+  vec_size_t qbits;
+  for (size_t i = 0; i < log2(gate.n_rows); i++)
+    qbits.push_back(qbit+i);
+  apply_gate(amps, qbits, gate, control);
+}
+
+/******************************************************/
+void QSystem::apply_gate(complex *amps,
+                const vec_size_t &qbits,
+                 const sp_cx_mat &gate,
+                          size_t control) {
+  if (_state == "vector") {
+    apply_gate(amps, size(), to_strides(qbits, size(), 0), gate, false,
+               control);
+  } else if (_state == "matrix") {
+    apply_gate(amps, 2*size(), to_strides(qbits, size(), 0), gate, false,
+               control);
+    apply_gate(amps, 2*size(), to_strides(qbits, size(), size()), gate, true,
+               control << size());
+  }
+}
+
+/******************************************************/
+void QSystem::apply_gate(complex *amps,
+                          size_t nqbits,
+                const vec_size_t &strides,
+                 const sp_cx_mat &gate,
+                            bool conj,
+                          size_t control) {
+  size_t size_n = strides.size();
+  size_t local = local_control(strides, control);
+  if (control and size_n-__builtin_popcountl(local) == 1) {
+    size_t target = (gate.n_rows-1) & ~local;
+    complex u[4] = {gate(local, local),
+                    gate(local | target, local),
+                    gate(local, local | target),
+                    gate(local | target, local | target)};
+    if (conj) 
+      for (auto &i : u) i = std::conj(i);
+    apply_ctrl(amps, nqbits, control, 
+               strides[size_n-__builtin_ctzl(target)-1], u);
+  } else if (control) {
+    apply_n(amps, nqbits, strides, gate, conj, control);
+  } else if (size_n == 1) {
+    cx_mat u{gate};
+    if (conj) u = arma::conj(u);
+    apply_1(amps, nqbits, strides[0], u.memptr());
+  } else if (size_n == 2) {
+    cx_mat u{gate};
+    if (conj) u = arma::conj(u);
+    if (strides[0] > strides[1]) {
+      apply_2(amps, nqbits, strides[0], strides[1], u.memptr());
+    } else {
+      /* the first qubit of the gate is the less significant one */
+      size_t swap[4] = {0, 2, 1, 3};
+      cx_mat us{4, 4};
+      for (size_t r = 0; r < 4; r++)
+        for (size_t c = 0; c < 4; c++)
+          us(r, c) = u(swap[r], swap[c]);
+      apply_2(amps, nqbits, strides[1], strides[0], us.memptr());
+    }
+  } else {
+    apply_n(amps, nqbits, strides, gate, conj, 0);
+  }
+}
+
+/******************************************************/
+void QSystem::apply_super(complex *amps,
+                 const vec_size_t &qbits,
+                  const sp_cx_mat &super) {
+  vec_size_t strides = to_strides(qbits, size(), size());
+  for (auto i : to_strides(qbits, size(), 0))
+    strides.push_back(i);
+  apply_gate(amps, 2*size(), strides, super, false, 0);
+}
+
+/******************************************************/
+void QSystem::apply_sparse(const vec_size_t &targets,
+                            const sp_cx_mat &gate,
+                                      size_t control) {
+  vec_size_t strides = to_strides(targets, size(), 0);
+  vec_size_t offset = offsets(strides);
+  size_t mask = offset.back();
+  auto local = [&](size_t i) {
+    size_t l = 0;
+    for (auto s : strides)
+      l = (l << 1) | ((i & s) != 0);
+    return l;
+  };
+
+  /* the elements of one column of the gate that an index is sent to */
+  using out_vec = std::vector<std::pair<size_t, complex>>;
+  auto outputs = [&](size_t i, bool conj, out_vec &out) {
+    out.clear();
+    if ((i & control) != control) {
+      out.emplace_back(i, 1.0);
+      return;
+    }
+    size_t l = local(i);
+    for (size_t k = gate.col_ptrs[l]; k < gate.col_ptrs[l+1]; k++) {
+      complex g = gate.values[k];
+      out.emplace_back((i & ~mask) | offset[gate.row_indices[k]],
+                       conj? std::conj(g) : g);
+    }
+  };
+
+  gate.sync();
+  size_t growth = 0;
+  for (size_t l = 0; l < gate.n_cols; l++)
+    growth = std::max<size_t>(growth, gate.col_ptrs[l+1]-gate.col_ptrs[l]);
+
+  qbits.sync();
+  SpBuilder result{qbits.n_rows, qbits.n_cols, qbits.n_nonzero*
+                   (_state == "vector"? growth : growth*growth)};
+  out_vec rows, cols;
+  for (size_t col = 0; col < qbits.n_cols; col++) {
+    for (size_t k = qbits.col_ptrs[col]; k < qbits.col_ptrs[col+1]; k++) {
+      outputs(qbits.row_indices[k], false, rows);
+      if (_state == "vector")
+        cols.assign(1, {col, 1.0});
+      else
+        outputs(col, true, cols);
+      for (auto &[r, g] : rows) {
+        for (auto &[c, h] : cols) {
+          result.set(r, c, g*h*complex{qbits.values[k]});
+        }
+      }
+    }
+  }
+
+  /* the elements sent to the same position are summed */
+  qbits = result.build(true);
+}
+
+/******************************************************/
+void QSystem::apply_sparse_super(const vec_size_t &targets,
+                                  const sp_cx_mat &super) {
+  vec_size_t strides = to_strides(targets, size(), 0);
+  vec_size_t offset = offsets(strides);
+  size_t mask = offset.back();
+  size_t size_n = strides.size();
+  size_t dim_n = 1ul << size_n;
+  auto local = [&](size_t i) {
+    size_t l = 0;
+    for (auto s : strides)
+      l = (l << 1) | ((i & s) != 0);
+    return l;
+  };
+
+  /* the local superoperator index of the element (row, col) is
+   * local(col)*dim_n+local(row), as in apply_super */
+  super.sync();
+  qbits.sync();
+  SpBuilder result{qbits.n_rows, qbits.n_cols, qbits.n_nonzero};
+  for (size_t col = 0; col < qbits.n_cols; col++) {
+    for (size_t k = qbits.col_ptrs[col]; k < qbits.col_ptrs[col+1]; k++) {
+      size_t row = qbits.row_indices[k];
+      size_t l = (local(col) << size_n) | local(row);
+      for (size_t s = super.col_ptrs[l]; s < super.col_ptrs[l+1]; s++) {
+        size_t b = super.row_indices[s];
+        result.set((row & ~mask) | offset[b & (dim_n-1)],
+                   (col & ~mask) | offset[b >> size_n],
+                   complex{super.values[s]}*complex{qbits.values[k]});
+      }
+    }
+  }
+
+  /* the elements sent to the same position are summed */
+  qbits = result.build(true);
+}
+
+/******************************************************/
+void QSystem::apply_sparse_diag(const std::vector<diag_term> &terms) {
+  std::vector<diag_mask> masks;
+  for (auto &[targets, d] : terms) {
+    size_t mask = 0;
+    for (auto q : targets)
+      mask |= 1ul << (size()-q-1);
+    masks.push_back(diag_mask{mask, d});
+  }
+  auto phase = [&](size_t i) {
+    complex value = 1;
+    for (auto &[mask, d] : masks)
+      value *= d[pext(i, mask)];
+    return value;
+  };
+
+  /* the elements keep their position, only the values change */
+  qbits.sync();
+  uvec row_indices(qbits.n_nonzero);
+  uvec col_ptrs(qbits.n_cols+1);
+  cx_vec values(qbits.n_nonzero);
+  col_ptrs[0] = 0;
+  for (size_t col = 0; col < qbits.n_cols; col++) {
+    complex col_phase = _state == "vector"? 1.0 : std::conj(phase(col));
+    for (size_t k = qbits.col_ptrs[col]; k < qbits.col_ptrs[col+1]; k++) {
+      row_indices[k] = qbits.row_indices[k];
+      values[k] = phase(row_indices[k])*col_phase*complex{qbits.values[k]};
+    }
+    col_ptrs[col+1] = qbits.col_ptrs[col+1];
+  }
+
+  qbits = sp_cx_mat(row_indices, col_ptrs, values, qbits.n_rows, qbits.n_cols);
+}
+/******************************************************/
+void QSystem::apply_1(complex *amps,
+                       size_t nqbits,
+                       size_t stride,
+                const complex *u) {
+  parallel(1ul << (nqbits-1), [&](size_t begin, size_t end) {
+    simd::apply_1(amps, stride, u, begin, end);
+  });
+}
+
+/******************************************************/
+void QSystem::apply_2(complex *amps,
+                       size_t nqbits,
+                       size_t stride_hi,
+                       size_t stride_lo,
+                const complex *u) {
+  parallel(1ul << (nqbits-2), [&](size_t begin, size_t end) {
+    simd::apply_2(amps, stride_hi, stride_lo, u, begin, end);
+  });
+}
+
+/******************************************************/
+void QSystem::apply_n(complex *amps,
+                       size_t nqbits,
+             const vec_size_t &strides,
+              const sp_cx_mat &gate,
+                         bool conj,
+                       size_t control) {
+  size_t dim_n = gate.n_rows;
+  size_t mask = 0;
+  for (auto i : strides)
+    mask |= i;
+  size_t outer = control & ~mask;
+  vec_size_t offset = offsets(strides);
+
+  /* the gate is the identity outside of the subspace whare all the control
+   * qubits are 1, so just those amplitudes are visited */
+  size_t local = local_control(strides, control);
+  vec_size_t index;
+  for (size_t k = 0; k < dim_n >> __builtin_popcountl(local); k++)
+    index.push_back(deposit(k, local) | local);
+
+  gate.sync();
+
+  parallel(1ul << nqbits >> __builtin_popcountl(mask | outer),
+           [&](size_t begin, size_t end) {
+    std::vector<complex> in(dim_n), out(dim_n);
+    for (size_t g = begin; g < end; g++) {
+      size_t j = deposit(g, mask | outer) | outer;
+      for (auto k : index) {
+        in[k] = amps[j+offset[k]];
+        out[k] = 0;
+      }
+      for (auto col : index) {
+        if (in[col] == 0.0) continue;
+        for (size_t k = gate.col_ptrs[col]; k < gate.col_ptrs[col+1]; k++) {
+          complex value = conj? std::conj(gate.values[k]) : gate.values[k];
+          out[gate.row_indices[k]] += value*in[col];
+        }
+      }
+      for (auto k : index)
+        amps[j+offset[k]] = out[k];
+    }
+  });
+}
+
+/******************************************************/
+void QSystem::apply_ctrl(complex *amps,
+                          size_t nqbits,
+                          size_t control,
+                          size_t target,
+                   const complex *u) {
+  size_t mask = control | target;
+  parallel(1ul << nqbits >> __builtin_popcountl(mask),
+           [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; k++) {
+      size_t i = deposit(k, mask) | control;
+      complex amp_0 = amps[i];
+      complex amp_1 = amps[i | target];
+      amps[i] = u[0]*amp_0 + u[2]*amp_1;
+      amps[i | target] = u[1]*amp_0 + u[3]*amp_1;
+    }
+  });
+}
+
+/******************************************************/
+void QSystem::apply_diag(complex *amps, const std::vector<diag_term> &terms) {
+  std::vector<diag_mask> masks;
+  for (auto &[qbits, d] : terms) {
+    size_t mask = 0;
+    for (auto q : qbits)
+      mask |= 1ul << (size()-q-1);
+    masks.push_back(diag_mask{mask, d});
+
+    if (_state == "matrix") {
+      vec_complex dconj;
+      for (auto &i : d)
+        dconj.push_back(std::conj(i));
+      masks.push_back(diag_mask{mask << size(), dconj});
+    }
+  }
+
+  apply_diag(amps, _state == "vector"? size() : 2*size(), masks);
+}
+
+/******************************************************/
+void QSystem::apply_diag(complex *amps,
+                          size_t nqbits,
+          const std::vector<diag_mask> &masks) {
+  /* phases that only change the amplitudes with all the mask bits set, like
+   * Z, S, T and cphase, visit just those amplitudes if that adds up to less
+   * than a full pass */
+  bool phase_only = true;
+  double fraction = 0;
+  for (auto &[mask, d] : masks) {
+    phase_only = phase_only and std::all_of(d.begin(), d.end()-1,
+                                  [](complex i) { return i == 1.0; });
+    fraction += 1.0/d.size();
+  }
+
+  if (phase_only and fraction <= 1) {
+    for (auto &[mask, d] : masks) {
+      complex phase = d.back();
+      parallel(1ul << nqbits >> __builtin_popcountl(mask),
+               [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) 
+          amps[deposit(k, mask) | mask] *= phase;
+      });
+    }
+  } else {
+    parallel(1ul << nqbits, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        complex value = 1;
+        for (auto &[mask, d] : masks)
+          value *= d[pext(i, mask)];
+        amps[i] *= value;
+      }
+    });
+  }
+}
+
+
+/******************************************************/
+void QSystem::apply_perm(complex *amps,
+                const vec_size_t &qbits,
+                const vec_size_t &perm,
+                          size_t control) {
+  if (_state == "vector") {
+    apply_perm(amps, size(), to_strides(qbits, size(), 0), perm, control);
+  } else if (_state == "matrix") {
+    apply_perm(amps, 2*size(), to_strides(qbits, size(), 0), perm, control);
+    apply_perm(amps, 2*size(), to_strides(qbits, size(), size()), perm,
+               control << size());
+  }
+}
+
+/******************************************************/
+void QSystem::apply_perm(complex *amps,
+                          size_t nqbits,
+                const vec_size_t &strides,
+                const vec_size_t &perm,
+                          size_t control) {
+  size_t dim_n = perm.size();
+  size_t mask = 0;
+  for (auto i : strides)
+    mask |= i;
+  size_t outer = control & ~mask;
+  vec_size_t offset = offsets(strides);
+
+  size_t local = local_control(strides, control);
+  vec_size_t index;
+  for (size_t k = 0; k < dim_n >> __builtin_popcountl(local); k++)
+    index.push_back(deposit(k, local) | local);
+
+  parallel(1ul << nqbits >> __builtin_popcountl(mask | outer),
+           [&](size_t begin, size_t end) {
+    std::vector<complex> in(dim_n);
+    for (size_t g = begin; g < end; g++) {
+      size_t j = deposit(g, mask | outer) | outer;
+      for (auto k : index) 
+        in[k] = amps[j+offset[k]];
+      for (auto k : index) 
+        amps[j+offset[perm[k]]] = in[k];
+    }
+  });
+}
+
+/******************************************************/
+void QSystem::apply_cnot(complex *amps, size_t control, size_t target) {
+  if (_state == "vector") {
+    apply_cnot(amps, size(), control, target);
+  } else if (_state == "matrix") {
+    apply_cnot(amps, 2*size(), control, target);
+    apply_cnot(amps, 2*size(), control << size(), target << size());
+  }
+}
+
+/******************************************************/
+void QSystem::apply_cnot(complex *amps,
+                          size_t nqbits,
+                          size_t control,
+                          size_t target) {
+  size_t mask = control | target;
+  parallel(1ul << nqbits >> __builtin_popcountl(mask),
+           [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; k++) {
+      size_t i = deposit(k, mask) | control;
+      std::swap(amps[i], amps[i | target]);
+    }
+  });
+}
+
+/******************************************************/
+void QSystem::apply_swap(complex *amps, size_t mask_a, size_t mask_b) {
+  if (_state == "vector") {
+    apply_swap(amps, size(), mask_a, mask_b);
+  } else if (_state == "matrix") {
+    apply_swap(amps, 2*size(), mask_a, mask_b);
+    apply_swap(amps, 2*size(), mask_a << size(), mask_b << size());
+  }
+}
+
+/******************************************************/
+void QSystem::apply_swap(complex *amps,
+                          size_t nqbits,
+                          size_t mask_a,
+                          size_t mask_b) {
+  size_t mask = mask_a | mask_b;
+  parallel(1ul << (nqbits-2), [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; k++) {
+      size_t i = deposit(k, mask) | mask_a;
+      std::swap(amps[i], amps[i ^ mask]);
+    }
+  });
+}
+
+/******************************************************/
+void QSystem::apply_qft(complex *amps,
+                         size_t qbit,
+                         size_t size_n,
+                           bool inver) {
+  if (_state == "vector") {
+    apply_qft(amps, size(), size()-qbit-size_n, size_n, inver);
+  } else if (_state == "matrix") {
+    apply_qft(amps, 2*size(), size()-qbit-size_n, size_n, inver);
+    apply_qft(amps, 2*size(), 2*size()-qbit-size_n, size_n, not inver);
+  }
+}
+
+/******************************************************/
+void QSystem::apply_qft(complex *amps,
+                         size_t nqbits,
+                         size_t low,
+                         size_t size_n,
+                           bool inver) {
+  /* the QFT is applied like in the circuit of Hadamards and controlled
+   * phases, but each Hadamard and the phases that follow it are a single
+   * butterfly pass, followed (or preceded, for the inverse) by the reversal
+   * of the qubits */
+  double pi = acos(-1);
+  vec_complex twiddle(1ul << (size_n-1));
+  for (size_t i = 0; i < twiddle.size(); i++)
+    twiddle[i] = std::polar(1.0, (inver? -2 : 2)*pi*i/(1ul << size_n));
+
+  auto reverse = [&]() {
+    for (size_t t = 0; t < size_n/2; t++)
+      apply_swap(amps, nqbits, 1ul << (low+size_n-t-1), 1ul << (low+t));
+  };
+
+  if (inver) reverse();
+
+  double r = 1/sqrt(2);
+  for (size_t s = 0; s < size_n; s++) {
+    size_t t = inver? size_n-s-1 : s;
+    size_t stride = 1ul << (low+size_n-t-1);
+    size_t mask = (1ul << (size_n-t-1))-1;
+    parallel(1ul << (nqbits-1), [&](size_t begin, size_t end) {
+      for (size_t k = begin; k < end; k++) {
+        size_t i = deposit(k, stride);
+        complex phase = twiddle[((i >> low) & mask) << t];
+        complex amp_0 = amps[i];
+        complex amp_1 = amps[i | stride];
+        if (inver) {
+          amp_1 *= phase;
+          amps[i] = r*(amp_0+amp_1);
+          amps[i | stride] = r*(amp_0-amp_1);
+        } else {
+          amps[i] = r*(amp_0+amp_1);
+          amps[i | stride] = r*(amp_0-amp_1)*phase;
+        }
+      }
+    });
+  }
+
+  if (not inver) reverse();
+}
+
+/******************************************************/
+void QSystem::parallel(size_t n, const std::function<void(size_t, size_t)> &f) {
+  size_t nblocks = (n+block_size-1)/block_size;
+  ThreadPool::global().run(_threads, nblocks, [&](size_t i) {
+    f(i*block_size, std::min(n, (i+1)*block_size));
+  });
+}
+
+/******************************************************/
+double QSystem::parallel_sum(size_t n,
+        const std::function<double(size_t, size_t)> &f) {
+  double sum = 0;
+  for (auto &i : parallel_partial(n, f))
+    sum += i;
+  return sum;
+}
+
+/******************************************************/
+vec_float QSystem::parallel_partial(size_t n,
+           const std::function<double(size_t, size_t)> &f) {
+  size_t nblocks = (n+block_size-1)/block_size;
+  vec_float partial(nblocks);
+  ThreadPool::global().run(_threads, nblocks, [&](size_t i) {
+    partial[i] = f(i*block_size, std::min(n, (i+1)*block_size));
+  });
+  return partial;
+}
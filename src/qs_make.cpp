@@ -23,48 +23,29 @@
  */ 
 
 #include "../header/qsystem.h"
+#include "../header/builder.h"
 
 using namespace arma;
 using namespace std::complex_literals;
 
-/*********************************************************/
-sp_cx_mat QSystem::make_gate(sp_cx_mat gate, size_t qbit) {
-  sp_cx_mat m;
-  size_t gate_size = log2(gate.n_rows);
-  if (qbit == 0) {
-    size_t eyesize = 1ul << (size()-gate_size);
-    m = kron(gate, eye<sp_cx_mat>(eyesize, eyesize));
-  } else if (qbit == size()-gate_size) {
-    size_t eyesize = 1ul << (size()-gate_size);
-    m = kron(eye<sp_cx_mat>(eyesize, eyesize), gate);
-  } else {
-    size_t eyesize = 1ul << qbit;
-    m = kron(eye<sp_cx_mat>(eyesize, eyesize), gate);
-    eyesize = 1ul << (size()-qbit-gate_size);
-    m = kron(m, eye<sp_cx_mat>(eyesize, eyesize));
-  }
-  return m;
-}
-
 /*********************************************************/
 sp_cx_mat QSystem::make_cnot(size_t target,
                          vec_size_t control,
                              size_t size_n) {
-  sp_cx_mat cnotm{1ul << size_n, 1ul << size_n};
-
-  for (size_t i = 0; i < (1lu << size_n); i++) {
-    bool cond = true;
+  size_t cmask = 0;
+  for (auto i : control)
+    cmask |= 1ul << (size_n-i-1);
 
-    for (size_t k = 0; (k < control.size()) and cond; k++)
-      cond = cond and ((1ul << (size_n-control[k]-1)) & i);
+  SpBuilder cnotm{1ul << size_n, 1ul << size_n, 1ul << size_n};
 
-    if (cond)
-      cnotm(i, i ^ (1ul  << (size_n-target-1))) = 1; 
+  for (size_t i = 0; i < (1lu << size_n); i++) {
+    if ((i & cmask) == cmask)
+      cnotm.set(i, i ^ (1ul  << (size_n-target-1)), 1); 
     else 
-      cnotm(i, i) = 1;
+      cnotm.set(i, i, 1);
   }
 
-  return cnotm;
+  return cnotm.build();
 }
 
 /******************************************************/
@@ -72,50 +53,109 @@ sp_cx_mat QSystem::make_cphase(complex phase,
                                 size_t target,
                             vec_size_t control,
                                 size_t size_n) {
-  sp_cx_mat cphasem{1ul << size_n, 1ul << size_n};
+  size_t mask = 1ul << (size_n-target-1);
+  for (auto i : control)
+    mask |= 1ul << (size_n-i-1);
 
-  for (size_t i = 0; i < (1lu << size_n); i++) {
-    bool cond = true;
+  SpBuilder cphasem{1ul << size_n, 1ul << size_n, 1ul << size_n};
 
-    for (size_t k = 0; (k < control.size()) and cond; k++)
-      cond = cond and ((1ul << (size_n-control[k]-1)) & i);
-
-    cphasem(i, i) = cond and (i & (1ul << (size_n-target-1)))? phase : 1; 
-  }
+  for (size_t i = 0; i < (1lu << size_n); i++) 
+    cphasem.set(i, i, (i & mask) == mask? phase : 1); 
 
-  return cphasem;
+  return cphasem.build();
 }
 
 /******************************************************/
 sp_cx_mat QSystem::make_swap(size_t size_n) {
-  sp_cx_mat swapm{1ul << size_n, 1ul << size_n};
+  SpBuilder swapm{1ul << size_n, 1ul << size_n, 1ul << size_n};
 
   for (size_t i = 0; i < (1ul << (size_n-1)); i++) {
     if (i%2 == 1) 
-      swapm((i | (1ul << (size_n-1))) ^ 1ul, i) = 1;
+      swapm.set((i | (1ul << (size_n-1))) ^ 1ul, i, 1);
     else 
-      swapm(i, i) = 1;
+      swapm.set(i, i, 1);
   }
 
   for (size_t i = 0; i < (1ul << (size_n-1)); i++) {
     if (i%2 == 0) 
-      swapm(i ^ 1ul, i | (1ul << (size_n-1))) = 1;
+      swapm.set(i ^ 1ul, i | (1ul << (size_n-1)), 1);
     else 
-      swapm(i | (1ul << (size_n-1)), i | (1ul << (size_n-1))) = 1;
+      swapm.set(i | (1ul << (size_n-1)), i | (1ul << (size_n-1)), 1);
 
   }
 
-  return swapm;
+  return swapm.build();
 }
 
 /******************************************************/
 sp_cx_mat QSystem::make_qft(size_t size_n) {
   double pi = acos(-1);
-  complex w = std::exp((2*pi*1i)/(pow(2, size_n)));
-  sp_cx_mat qftm{1ul << size_n, 1ul << size_n};
-  for (size_t i = 0; i < (1ul << size_n); i++) 
-    for (size_t j = 0; j < (1ul << size_n); j++) 
-      qftm(i, j) = (1/sqrt(1 << size_n))*pow(w, i*j);
-  return qftm;
+  size_t dim_n = 1ul << size_n;
+  vec_complex w(dim_n);
+  for (size_t i = 0; i < dim_n; i++)
+    w[i] = std::polar(1/sqrt(dim_n), 2*pi*i/dim_n);
+
+  SpBuilder qftm{dim_n, dim_n, dim_n*dim_n};
+  for (size_t j = 0; j < dim_n; j++) 
+    for (size_t i = 0; i < dim_n; i++) 
+      qftm.set(i, j, w[(i*j) % dim_n]);
+  return qftm.build();
+}
+
+/******************************************************/
+sp_cx_mat QSystem::make_controlled(const sp_cx_mat &gate,
+                                          vec_size_t targets,
+                                          vec_size_t control,
+                                              size_t size_n) {
+  size_t cmask = 0;
+  for (auto i : control)
+    cmask |= 1ul << (size_n-i-1);
+
+  size_t block = 0;
+  for (auto i : targets)
+    block |= 1ul << (size_n-i-1);
+
+  /* position of the bits of a gate index in the target qubits */
+  vec_size_t index(gate.n_rows);
+  for (size_t j = 0; j < gate.n_rows; j++) 
+    for (size_t k = 0; k < targets.size(); k++)
+      if (j & (1ul << (targets.size()-k-1)))
+        index[j] |= 1ul << (size_n-targets[k]-1);
+
+  gate.sync();
+  SpBuilder ctrlm{1ul << size_n, 1ul << size_n, 
+                  (1ul << size_n)+(gate.n_nonzero << (size_n-targets.size()))};
+
+  for (size_t i = 0; i < (1ul << size_n); i++) {
+    if ((i & cmask) != cmask) {
+      ctrlm.set(i, i, 1);
+      continue;
+    }
+    size_t col = std::find(index.begin(), index.end(), i & block)
+               - index.begin();
+    for (size_t k = gate.col_ptrs[col]; k < gate.col_ptrs[col+1]; k++) 
+      ctrlm.set((i & ~block) | index[gate.row_indices[k]], i, gate.values[k]);
+  }
+
+  return ctrlm.build();
+}
+
+/******************************************************/
+sp_cx_mat QSystem::make_diag(const std::vector<diag_term> &terms,
+                                                 size_t size_n) {
+  SpBuilder diagm{1ul << size_n, 1ul << size_n, 1ul << size_n};
+
+  for (size_t i = 0; i < (1ul << size_n); i++) {
+    complex value = 1;
+    for (auto &[qbits, d] : terms) {
+      size_t index = 0;
+      for (auto q : qbits) 
+        index = (index << 1) | ((i >> (size_n-q-1)) & 1);
+      value *= d[index];
+    }
+    diagm.set(i, i, value);
+  }
+
+  return diagm.build();
 }
 
@@ -23,6 +23,7 @@
  */  
 
 #include "../header/qsystem.h"
+#include "../header/builder.h"
 
 using namespace arma;
 
@@ -32,51 +33,237 @@ void QSystem::measure(size_t qbit, size_t count) {
   valid_count(qbit, count);
 
   sync();
-  count += qbit;
-  for (; qbit < count; qbit++) {
-    double pm = 0;
-    if (_state == "vector") {
-      for (auto i = qbits.begin(); i != qbits.end(); ++i) {
-        if (~i.row() & 1ul << (size()-qbit-1)) {
-          auto valor = abs((cx_double) *i);
-          pm += valor*valor;
-        }
-      }
-    } else if (_state == "matrix") {
-      sp_cx_mat m_aux = qbits.diag(); 
-      for (auto i = m_aux.begin(); i != m_aux.end(); ++i) 
-        if (~i.row() & 1ul << (size()-qbit-1)) 
-          pm += (*i).real();
+
+  /* a basis state drawn from the whole state has the value of the
+   * measured qubits with its marginal probability, so one draw measures
+   * all of them at once */
+  size_t mask = ((1ul << count)-1) << (size()-qbit-count);
+  size_t result = draw({_rng.uniform()})[0] & mask;
+
+  for (size_t i = qbit; i < qbit+count; i++) {
+    Bit mea = result & (1ul << (size()-i-1))? ONE : ZERO;
+    if (i < _size) _bits[i] = mea;
+      else an_bits[i-_size] = mea;
+  }
+
+  collapse(mask, result);
+
+  adapt_storage();
+}
+
+/******************************************************/
+vec_size_t QSystem::draw(vec_float r) {
+  /* the draws are sorted, so the basis states are found in a single sweep
+   * of the cumulative probability */
+  std::sort(r.begin(), r.end());
+  vec_size_t index(r.size());
+
+  if (_dense) {
+    complex *amps = dqbits.memptr();
+    size_t dim = dqbits.n_rows;
+    bool vector = _state == "vector";
+    auto prob = [&](size_t i) {
+      return vector? std::norm(amps[i]) : amps[i*(dim+1)].real();
+    };
+
+    vec_float partial = parallel_partial(dim, [&](size_t begin, size_t end) {
+      double sum = 0;
+      for (size_t i = begin; i < end; i++)
+        sum += prob(i);
+      return sum;
+    });
+
+    double total = 0;
+    for (auto &i : partial)
+      total += i;
+
+    /* the draws that fall in each block are found from the partial sums,
+     * the blocks have the same power of 2 size used by parallel */
+    size_t block = dim/partial.size();
+    vec_size_t first(partial.size()+1, r.size());
+    vec_float offset(partial.size());
+    double acc = 0;
+    size_t k = 0;
+    for (size_t b = 0; b < partial.size(); b++) {
+      first[b] = k;
+      offset[b] = acc;
+      if (partial[b] != 0) 
+        for (; k < r.size() and r[k]*total <= acc+partial[b]; k++);
+      acc += partial[b];
     }
+    /* rounding can leave the last draws past the end, they go to the last
+     * block with a non-zero probability */
+    if (k < r.size()) 
+      for (size_t b = partial.size(); b > 0 and partial[b-1] == 0; b--)
+        first[b-1] = r.size();
 
-    auto result = [&](Bit mea, double pm) {
-      auto lnot = mea == ZERO? [](size_t i) { return ~i; } 
-                             : [](size_t i) { return i; };
-      if (qbit < _size) _bits[qbit] = mea;
-        else an_bits[qbit-_size] = mea;
-
-      sp_cx_mat qbitsm{1ul << size(),
-                       _state == "vector"? 1 : 1ul << size()};
-
-      if (_state == "vector") {
-        for (auto i = qbits.begin(); i != qbits.end(); ++i) 
-          if (lnot(i.row()) & 1ul << (size()-qbit-1))  
-            qbitsm(i.row(), 0) = (complex)(*i)/sqrt(pm);
-      } else if (_state == "matrix") {
-        for (auto i = qbits.begin(); i != qbits.end(); ++i) 
-          if (lnot(i.row()) & 1ul << (size()-qbit-1)
-              and lnot(i.col()) & 1ul << (size()-qbit-1)) 
-            qbitsm(i.row(), i.col()) = (complex)(*i)/pm;
+    parallel(dim, [&](size_t begin, size_t end) {
+      size_t b = begin/block;
+      size_t k = first[b];
+      double acc = offset[b];
+      size_t last = begin;
+      for (size_t i = begin; i < end and k < first[b+1]; i++) {
+        if (prob(i) == 0) continue;
+        last = i;
+        acc += prob(i);
+        for (; k < first[b+1] and r[k]*total <= acc; k++)
+          index[k] = i;
       }
+      for (; k < first[b+1]; k++) 
+        index[k] = last;
+    });
+    return index;
+  }
 
-      return qbitsm;
-    };
-    
-    if (pm != 0 and double(std::rand()) / double(RAND_MAX) <= pm) 
-      qbits = result(ZERO, pm);
-    else 
-      qbits = result(ONE, 1.0 - pm);
+  sp_cx_mat m_aux = _state == "vector"? qbits : sp_cx_mat{qbits.diag()};
+  auto prob = [&](complex amp) {
+    return _state == "vector"? std::norm(amp) : amp.real();
+  };
+
+  double total = 0;
+  for (auto i = m_aux.begin(); i != m_aux.end(); ++i) 
+    total += prob(*i);
+
+  double acc = 0;
+  size_t k = 0;
+  size_t last = 0;
+  for (auto i = m_aux.begin(); i != m_aux.end() and k < r.size(); ++i) {
+    if (prob(*i) == 0) continue;
+    last = i.row();
+    acc += prob(*i);
+    for (; k < r.size() and r[k]*total <= acc; k++)
+      index[k] = last;
   }
+  for (; k < r.size(); k++)
+    index[k] = last;
+  return index;
+}
+
+/******************************************************/
+void QSystem::collapse(size_t mask, size_t result) {
+  size_t dim = 1ul << size();
+  bool vector = _state == "vector";
+
+  if (_dense) {
+    complex *amps = dqbits.memptr();
+
+    /* just the amplitudes of the result are summed, the measured qubits
+     * are contiguous so their bits are inserted with a shift */
+    size_t count = __builtin_popcountl(mask);
+    size_t low = (mask & -mask)-1;
+    double pm = parallel_sum(dim >> count, [&](size_t begin, size_t end) {
+      double sum = 0;
+      for (size_t k = begin; k < end; k++) {
+        size_t i = ((k & ~low) << count) | (k & low) | result;
+        sum += vector? std::norm(amps[i]) : amps[i*(dim+1)].real();
+      }
+      return sum;
+    });
+    double scale = vector? 1/sqrt(pm) : 1/pm;
+
+    if (vector) {
+      parallel(dim, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) 
+          amps[i] *= (i & mask) == result? scale : 0.0;
+      });
+    } else {
+      parallel(dim, [&](size_t begin, size_t end) {
+        for (size_t col = begin; col < end; col++) {
+          complex *column = amps+col*dim;
+          if ((col & mask) != result) {
+            std::fill(column, column+dim, 0.0);
+            continue;
+          }
+          for (size_t row = 0; row < dim; row++) 
+            column[row] *= (row & mask) == result? scale : 0.0;
+        }
+      });
+    }
+    return;
+  }
+
+  auto kept = [&](sp_cx_mat::const_iterator &i) {
+    return (i.row() & mask) == result 
+           and (vector or (i.col() & mask) == result);
+  };
+
+  double pm = 0;
+  const sp_cx_mat &m = qbits;
+  for (auto i = m.begin(); i != m.end(); ++i) 
+    if (kept(i)) 
+      pm += vector? std::norm((complex) *i) : 
+                    (i.row() == i.col()? ((complex) *i).real() : 0);
+  double scale = vector? 1/sqrt(pm) : 1/pm;
+
+  /* the elements that are kept are already in order, so the new matrix
+   * is built in a single pass */
+  SpBuilder qbitsm{dim, vector? 1 : dim, m.n_nonzero};
+  for (auto i = m.begin(); i != m.end(); ++i) 
+    if (kept(i))
+      qbitsm.set(i.row(), i.col(), scale*((complex) *i));
+
+  qbits = qbitsm.build();
+}
+
+/******************************************************/
+void QSystem::reset(size_t qbit) {
+  valid_qbit("qbit", qbit);
+
+  size_t dim = 1ul << size();
+  size_t mask = 1ul << (size()-qbit-1);
+
+  if (_state == "vector") {
+    measure(qbit);
+    Bit mea = qbit < _size? _bits[qbit] : an_bits[qbit-_size];
+    if (mea == ZERO) 
+      return;
+
+    /* every amplitude left has the qubit in 1 */
+    if (_dense) {
+      complex *amps = dqbits.memptr();
+      parallel(dim, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) 
+          if (not (i & mask)) std::swap(amps[i], amps[i | mask]);
+      });
+    } else {
+      const sp_cx_mat &m = qbits;
+      SpBuilder qbitsm{dim, 1, m.n_nonzero};
+      for (auto i = m.begin(); i != m.end(); ++i) 
+        qbitsm.set(i.row() ^ mask, 0, *i);
+      qbits = qbitsm.build();
+    }
+    return;
+  }
+
+  sync();
+
+  /* rho' = |0><0|rho|0><0| + |0><1|rho|1><0|, the block of the qubit in 1
+   * is added to the block in 0 and cleared */
+  if (_dense) {
+    complex *amps = dqbits.memptr();
+    parallel(dim, [&](size_t begin, size_t end) {
+      for (size_t col = begin; col < end; col++) {
+        if (col & mask) continue;
+        complex *col0 = amps+col*dim;
+        complex *col1 = amps+(col | mask)*dim;
+        for (size_t row = 0; row < dim; row++) 
+          if (not (row & mask)) {
+            col0[row] += col1[row | mask];
+            col0[row | mask] = 0;
+          }
+        std::fill(col1, col1+dim, 0.0);
+      }
+    });
+  } else {
+    const sp_cx_mat &m = qbits;
+    SpBuilder qbitsm{dim, dim, m.n_nonzero};
+    for (auto i = m.begin(); i != m.end(); ++i) 
+      if (((i.row() ^ i.col()) & mask) == 0)
+        qbitsm.set(i.row() & ~mask, i.col() & ~mask, *i);
+    qbits = qbitsm.build(true);
+  }
+
+  adapt_storage();
 }
 
 /******************************************************/
@@ -93,3 +280,111 @@ std::vector<int> QSystem::bits() {
     vec.push_back(an_bits[i]);
   return vec;
 }
+
+/******************************************************/
+PyObject* QSystem::sample(vec_size_t qbits, size_t shots) {
+  valid_sample(qbits, shots);
+
+  sync();
+
+  return to_dict(counts(qbits, shots));
+}
+
+/******************************************************/
+std::map<size_t, size_t> QSystem::counts(const vec_size_t &qbits, 
+                                                   size_t shots) {
+  /* each shot has its own index in a new stream, so the draws do not
+   * depend on the number of threads */
+  Philox rng = _rng.split();
+  vec_float r(shots);
+  parallel(shots, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      r[i] = rng.uniform(i);
+  });
+
+  std::map<size_t, size_t> counts;
+  for (auto i : draw(r)) {
+    size_t result = 0;
+    for (auto j : qbits) 
+      result = (result << 1) | ((i >> (size()-j-1)) & 1);
+    counts[result]++;
+  }
+  return counts;
+}
+
+/******************************************************/
+PyObject* QSystem::to_dict(const std::map<size_t, size_t> &counts) {
+  PyObject* result = PyDict_New();
+  for (auto &i : counts) {
+    PyObject* key = PyLong_FromSize_t(i.first);
+    PyObject* value = PyLong_FromSize_t(i.second);
+    PyDict_SetItem(result, key, value);
+    Py_DECREF(key);
+    Py_DECREF(value);
+  }
+
+  return result;
+}
+
+/******************************************************/
+double QSystem::expectation(vec_str terms, vec_float coeffs) {
+  valid_pauli(terms, coeffs);
+
+  sync();
+
+  /* a Pauli string is i^ny X^x Z^z and takes |j> to 
+   * i^ny (-1)^|j&z| |j^x>, so the terms with the same x mask visit the
+   * same pairs of amplitudes and are evaluated together */
+  std::map<size_t, std::vector<std::pair<size_t, complex>>> groups;
+  for (size_t k = 0; k < terms.size(); k++) {
+    size_t x = 0, z = 0;
+    complex phase = coeffs[k];
+    for (size_t i = 0; i < terms[k].size(); i++) {
+      size_t mask = 1ul << (size()-i-1);
+      if (terms[k][i] == 'X' or terms[k][i] == 'Y') x |= mask;
+      if (terms[k][i] == 'Z' or terms[k][i] == 'Y') z |= mask;
+      if (terms[k][i] == 'Y') phase *= complex{0, 1};
+    }
+    groups[x].push_back({z, phase});
+  }
+
+  double result = 0;
+  for (auto &group : groups) {
+    size_t x = group.first;
+    auto &zs = group.second;
+    auto weight = [&](size_t j) {
+      complex w = 0;
+      for (auto &i : zs)
+        w += __builtin_parityl(j & i.first)? -i.second : i.second;
+      return w;
+    };
+
+    if (_dense) {
+      complex *amps = dqbits.memptr();
+      size_t dim = dqbits.n_rows;
+      bool vector = _state == "vector";
+      result += parallel_sum(dim, [&](size_t begin, size_t end) {
+        double sum = 0;
+        for (size_t j = begin; j < end; j++) {
+          complex amp = vector? std::conj(amps[j^x])*amps[j] 
+                              : amps[j+(j^x)*dim];
+          if (amp != 0.0) 
+            sum += (amp*weight(j)).real();
+        }
+        return sum;
+      });
+    } else if (_state == "vector") {
+      const sp_cx_mat &m = qbits;
+      for (auto i = m.begin(); i != m.end(); ++i) {
+        complex amp = std::conj(m(i.row()^x, 0))*((complex) *i);
+        result += (amp*weight(i.row())).real();
+      }
+    } else if (_state == "matrix") {
+      for (auto i = qbits.begin(); i != qbits.end(); ++i) 
+        if (i.col() == (i.row()^x)) 
+          result += (((complex) *i)*weight(i.row())).real();
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,125 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#include "../header/qsystem.h"
+
+using namespace arma;
+
+static const double dense_fill  = 1.0/4.0;
+static const double sparse_fill = 1.0/16.0;
+
+/******************************************************/
+void QSystem::to_dense() {
+  if (_dense) return;
+
+  dqbits = Amplitudes{qbits.n_rows, qbits.n_cols, reserved(qbits.n_cols)};
+  complex *amps = dqbits.memptr();
+
+  qbits.sync();
+  for (size_t col = 0; col < qbits.n_cols; col++) 
+    for (size_t k = qbits.col_ptrs[col]; k < qbits.col_ptrs[col+1]; k++) 
+      amps[qbits.row_indices[k]+col*qbits.n_rows] = qbits.values[k];
+
+  qbits.reset();
+  _dense = true;
+}
+
+/******************************************************/
+void QSystem::to_sparse() {
+  if (not _dense) return;
+
+  qbits = sp_cx_mat{dqbits.mat()};
+  dqbits = Amplitudes{};
+  _dense = false;
+}
+
+/******************************************************/
+void QSystem::adapt_storage() {
+  if (_storage == "sparse") {
+    to_sparse();
+  } else if (_storage == "dense") {
+    to_dense();
+  } else if (_dense) {
+    /* a reserved buffer is kept, as the ancillas will need it */
+    if (_reserve) 
+      return;
+    complex *amps = dqbits.memptr();
+    size_t nonzero = parallel_sum(dqbits.n_elem, [&](size_t begin, size_t end) {
+      size_t count = 0;
+      for (size_t i = begin; i < end; i++)
+        if (amps[i] != 0.0) count++;
+      return double(count);
+    });
+    if (nonzero < sparse_fill*dqbits.n_elem)
+      to_sparse();
+  } else if (qbits.n_nonzero > dense_fill*qbits.n_elem) {
+    to_dense();
+  }
+}
+
+/******************************************************/
+sp_cx_mat QSystem::sparse_qbits() {
+  if (_dense) 
+    return sp_cx_mat{dqbits.mat()};
+  else 
+    return qbits;
+}
+
+/******************************************************/
+bool QSystem::sparse_fits(size_t growth) {
+  /* each non-zero element can be sent to at most growth elements, with
+   * "auto" storage the state goes dense first if it would be dense after */
+  if (_dense) 
+    return false;
+  else if (_storage == "sparse") 
+    return true;
+  else 
+    return qbits.n_nonzero*double(growth) <= dense_fill*qbits.n_elem;
+}
+
+/******************************************************/
+bool QSystem::sparse_fits(const sp_cx_mat &gate, bool super) {
+  gate.sync();
+  size_t growth = 0;
+  for (size_t col = 0; col < gate.n_cols; col++)
+    growth = std::max<size_t>(growth, gate.col_ptrs[col+1]-gate.col_ptrs[col]);
+  /* a superoperator already acts on both sides of the density matrix */
+  return sparse_fits(_state == "vector" or super? growth : growth*growth);
+}
+
+/******************************************************/
+size_t QSystem::reserved(size_t n_cols) {
+  if (_reserve == 0) 
+    return 0;
+  size_t dim = 1ul << (_size+_reserve);
+  return n_cols > 1 ? dim*dim : dim;
+}
+
+/******************************************************/
+void QSystem::store(sp_cx_mat m) {
+  qbits = m;
+  dqbits = Amplitudes{};
+  _dense = false;
+  adapt_storage();
+}
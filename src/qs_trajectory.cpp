@@ -0,0 +1,111 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "../header/qsystem.h"
+#include "../header/pool.h"
+
+using namespace arma;
+
+/******************************************************/
+double QSystem::trajectory_expectation(Circuit &circuit,
+                                          size_t ntraj,
+                                         vec_str terms,
+                                       vec_float coeffs,
+                                       vec_float params) {
+  valid_trajectories(ntraj);
+  valid_circuit(circuit, params);
+  valid_pauli(terms, coeffs);
+
+  vec_float values(ntraj);
+  trajectories(circuit, ntraj, params, [&](size_t t, QSystem &q) {
+    values[t] = q.expectation(terms, coeffs);
+  });
+
+  /* summed in order, so the result does not depend on the threads */
+  double sum = 0;
+  for (auto &i : values)
+    sum += i;
+  return sum/ntraj;
+}
+
+/******************************************************/
+PyObject* QSystem::trajectory_sample(Circuit &circuit,
+                                        size_t ntraj,
+                                    vec_size_t qbits,
+                                        size_t shots,
+                                     vec_float params) {
+  valid_trajectories(ntraj);
+  valid_circuit(circuit, params);
+  valid_sample(qbits, shots);
+
+  std::vector<std::map<size_t, size_t>> counts(ntraj);
+  trajectories(circuit, ntraj, params, [&](size_t t, QSystem &q) {
+    size_t n = shots/ntraj + (t < shots%ntraj? 1 : 0);
+    if (n != 0) 
+      counts[t] = q.counts(qbits, n);
+  });
+
+  std::map<size_t, size_t> total;
+  for (auto &i : counts)
+    for (auto &j : i)
+      total[j.first] += j.second;
+
+  return to_dict(total);
+}
+
+/******************************************************/
+void QSystem::trajectories(Circuit &circuit,
+                            size_t ntraj,
+                  const vec_float &params,
+  const std::function<void(size_t, QSystem&)> &f) {
+  sync();
+
+  Philox rng = _rng.split();
+  size_t nblocks = std::min(_threads, ntraj);
+
+  /* each block runs its trajectories one after the other in its own state
+   * vector, and the trajectory t always draws from the stream t, so the
+   * results do not depend on how the trajectories are split */
+  ThreadPool::global().run(nblocks, nblocks, [&](size_t b) {
+    QSystem worker{size(), gates, 0, "vector", _storage};
+    for (size_t t = b; t < ntraj; t += nblocks) {
+      if (_dense) {
+        worker.dqbits = Amplitudes{dqbits.n_rows, 1};
+        std::copy(dqbits.memptr(), dqbits.memptr()+dqbits.n_elem,
+                  worker.dqbits.memptr());
+        worker.qbits.reset();
+        worker._dense = true;
+        worker.adapt_storage();
+      } else {
+        worker.store(qbits);
+      }
+      worker._rng = rng.split(t);
+
+      worker.run(circuit, params);
+      worker.sync();
+      f(t, worker);
+    }
+  });
+}
@@ -23,8 +23,10 @@
  */                                                                               
 
 #include "../header/qsystem.h"
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <thread>
 
 using namespace arma;
 
@@ -32,15 +34,24 @@ using namespace arma;
 QSystem::QSystem(size_t nqbits,
                   Gates& gates,
                   size_t seed,
-             std::string state) :
+             std::string state,
+             std::string storage,
+                  size_t reserve) :
   gates{gates},
   _size{nqbits},
   _state{state},
   _ops{new Gate_aux[nqbits]()},
   _sync{true},
   qbits{1lu << nqbits, state == "matrix" ? 1lu << nqbits : 1},
+  _storage{storage},
+  _dense{false},
+  _threads{1},
+  _rng{seed},
+  _cache_bytes{0},
+  _cache_max{1ul << 26},
   _bits{new Bit[nqbits]()}, 
   an_size{0},
+  _reserve{reserve},
   an_ops{nullptr},
   an_bits{nullptr}
 {
@@ -51,8 +62,16 @@ QSystem::QSystem(size_t nqbits,
         << state << "\"";
     throw std::invalid_argument{err.str()};
   }
+  if (storage != "sparse" and storage != "dense" and storage != "auto") {
+    sstr err;
+    err << "\'storage\' argument must have value " 
+        <<  "\"sparse\", \"dense\" or \"auto\", not \""
+        << storage << "\"";
+    throw std::invalid_argument{err.str()};
+  }
+  valid_reserve(state, nqbits);
   qbits(0,0) = 1;
-  std::srand(seed);
+  adapt_storage();
 }
 
 
@@ -104,14 +123,15 @@ std::string QSystem::__str__() {
   };
 
   sync();
+  sp_cx_mat m = sparse_qbits();
   std::stringstream out;
   if (state() == "vector") {
-    for (auto i = qbits.begin(); i != qbits.end(); ++i) {
+    for (auto i = m.begin(); i != m.end(); ++i) {
       if (abs((cx_double)*i) < 1e-14) continue; 
       out << cx_to_str(*i) << to_bits(i.row()) << '\n';
     }
   } else if (state() == "matrix") {
-    for (auto i = qbits.begin(); i != qbits.end(); ++i) {
+    for (auto i = m.begin(); i != m.end(); ++i) {
       auto aux = cx_to_str(*i);
       out << "(" << i.row() << ", " << i.col() << ")    " <<
         (aux == ""? "1" : aux)  << std::endl;
@@ -128,27 +148,28 @@ size_t QSystem::size() {
 /******************************************************/
 PyObject* QSystem::get_qbits() {
   sync();
-  qbits.sync();
+  sp_cx_mat m = sparse_qbits();
+  m.sync();
 
   PyObject* csc_tuple = PyTuple_New(3);
-  PyObject* val = PyList_New(qbits.n_nonzero);
-  PyObject* row_ind = PyList_New(qbits.n_nonzero);
-  for (size_t i = 0; i < qbits.n_nonzero; i++) {
-    PyList_SetItem(val, i, PyComplex_FromDoubles(qbits.values[i].real(),
-                                                 qbits.values[i].imag()));
-    PyList_SetItem(row_ind, i, PyLong_FromLong(qbits.row_indices[i]));
+  PyObject* val = PyList_New(m.n_nonzero);
+  PyObject* row_ind = PyList_New(m.n_nonzero);
+  for (size_t i = 0; i < m.n_nonzero; i++) {
+    PyList_SetItem(val, i, PyComplex_FromDoubles(m.values[i].real(),
+                                                 m.values[i].imag()));
+    PyList_SetItem(row_ind, i, PyLong_FromLong(m.row_indices[i]));
   }
   PyTuple_SetItem(csc_tuple, 0, val);
   PyTuple_SetItem(csc_tuple, 1, row_ind);
 
-  PyObject* col_ptr = PyList_New(qbits.n_cols+1);
-  for (size_t i = 0; i < qbits.n_cols+1; i++) 
-    PyList_SetItem(col_ptr, i, PyLong_FromLong(qbits.col_ptrs[i]));
+  PyObject* col_ptr = PyList_New(m.n_cols+1);
+  for (size_t i = 0; i < m.n_cols+1; i++) 
+    PyList_SetItem(col_ptr, i, PyLong_FromLong(m.col_ptrs[i]));
   PyTuple_SetItem(csc_tuple, 2, col_ptr);
 
   PyObject* size_tuple = PyTuple_New(2);
-  PyTuple_SetItem(size_tuple, 0, PyLong_FromLong(qbits.n_rows));
-  PyTuple_SetItem(size_tuple, 1, PyLong_FromLong(qbits.n_cols));
+  PyTuple_SetItem(size_tuple, 0, PyLong_FromLong(m.n_rows));
+  PyTuple_SetItem(size_tuple, 1, PyLong_FromLong(m.n_cols));
 
   PyObject* result = PyTuple_New(2);
 
@@ -164,14 +185,14 @@ void QSystem::set_qbits(vec_size_t row_ind,
                        vec_complex values,
                             size_t nqbits,
                        std::string state) {
-  qbits = sp_cx_mat(conv_to<uvec>::from(row_ind),
-                    conv_to<uvec>::from(col_ptr),
-                    cx_vec(values),
-                    1ul << nqbits,
-                    state == "vector"? 1ul : 1ul << nqbits);
-                    
+  valid_reserve(state, nqbits);
   this->_state = state;
   _size = nqbits;
+  store(sp_cx_mat(conv_to<uvec>::from(row_ind),
+                  conv_to<uvec>::from(col_ptr),
+                  cx_vec(values),
+                  1ul << nqbits,
+                  state == "vector"? 1ul : 1ul << nqbits));
   clear();
 }
 
@@ -188,13 +209,17 @@ void QSystem::change_to(std::string new_state) {
   if (new_state == _state) 
     return;
 
+  valid_reserve(new_state, _size);
+  sync();
+  sp_cx_mat m = sparse_qbits();
+
   if (new_state == "matrix") {
-    qbits = qbits*qbits.t();
+    store(m*m.t());
   } else if (new_state == "vector") {
     sp_cx_mat nqbits{1ul << size(), 1};
     for (size_t i = 0; i < 1ul << size(); i++)
-      nqbits(i,0) = sqrt(qbits(i,i).real());
-    qbits = nqbits;
+      nqbits(i,0) = sqrt(m(i,i).real());
+    store(nqbits);
   }
   
   _state = new_state;
@@ -205,16 +230,52 @@ std::string QSystem::state() {
   return _state;
 }
 
+/******************************************************/
+std::string QSystem::storage() {
+  return _dense? "dense" : "sparse";
+}
+
+/******************************************************/
+void QSystem::set_threads(size_t nthreads) {
+  _threads = nthreads == 0? std::max(1u, std::thread::hardware_concurrency())
+                          : nthreads;
+}
+
+/******************************************************/
+size_t QSystem::threads() {
+  return _threads;
+}
+
+/******************************************************/
+void QSystem::set_cache(size_t nbytes) {
+  _cache_max = nbytes;
+  while (_cache_bytes > _cache_max) {
+    auto &m = _cache.back().second;
+    _cache_bytes -= m.n_nonzero*(sizeof(complex)+sizeof(uword))
+                  + (m.n_cols+1)*sizeof(uword);
+    _cache_map.erase(_cache.back().first);
+    _cache.pop_back();
+  }
+}
+
+/******************************************************/
+size_t QSystem::cache() {
+  return _cache_max;
+}
+
 /******************************************************/
 void QSystem::save(std::string path) {
   sync();
-  qbits.save(path, arma_binary);
+  sparse_qbits().save(path, arma_binary);
 }
 
 void QSystem::load(std::string path) {
-  qbits.load(path, arma_binary);
-  _size = log2(qbits.n_rows);
-  _state = qbits.n_cols > 1 ? "matrix" : "vector";
+  sp_cx_mat m;
+  m.load(path, arma_binary);
+  valid_reserve(m.n_cols > 1 ? "matrix" : "vector", log2(m.n_rows));
+  _size = log2(m.n_rows);
+  _state = m.n_cols > 1 ? "matrix" : "vector";
+  store(m);
   clear();
 }
 
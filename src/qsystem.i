@@ -63,6 +63,7 @@ using size_t = long unsigned;
 
 %include "../header/qsystem.h"
 %include "../header/gates.h"
+%include "../header/circuit.h"
 %include "../header/using.h"
 
 %pythoncode %{
@@ -0,0 +1,342 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+#include "../header/simd.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) and (defined(__GNUC__) or defined(__clang__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+/*********************************************************/
+static inline size_t insert0(size_t i, size_t bit) {
+  return ((i >> bit) << (bit+1)) | (i & ((1ul << bit)-1));
+}
+
+/*********************************************************/
+static void apply_1_scalar(complex *amps,
+                            size_t stride,
+                     const complex *u,
+                            size_t begin,
+                            size_t end) {
+  size_t bit = log2(stride);
+  for (size_t k = begin; k < end; k++) {
+    size_t i = insert0(k, bit);
+    complex a0 = amps[i];
+    complex a1 = amps[i+stride];
+    amps[i]        = u[0]*a0 + u[2]*a1;
+    amps[i+stride] = u[1]*a0 + u[3]*a1;
+  }
+}
+
+/*********************************************************/
+static void apply_2_scalar(complex *amps,
+                            size_t stride_hi,
+                            size_t stride_lo,
+                     const complex *u,
+                            size_t begin,
+                            size_t end) {
+  size_t bit_hi = log2(stride_hi);
+  size_t bit_lo = log2(stride_lo);
+  for (size_t k = begin; k < end; k++) {
+    size_t i = insert0(insert0(k, bit_lo), bit_hi);
+    size_t index[4] = {i, i+stride_lo, i+stride_hi, i+stride_hi+stride_lo};
+    complex a[4];
+    for (size_t c = 0; c < 4; c++)
+      a[c] = amps[index[c]];
+    for (size_t r = 0; r < 4; r++)
+      amps[index[r]] = u[r]*a[0] + u[r+4]*a[1] + u[r+8]*a[2] + u[r+12]*a[3];
+  }
+}
+
+#ifdef SIMD_X86
+/*********************************************************/
+__attribute__((target("avx2,fma")))
+static inline __m256d cmul(__m256d ur, __m256d ui, __m256d x) {
+  return _mm256_fmaddsub_pd(ur, x, _mm256_mul_pd(ui, _mm256_permute_pd(x, 0x5)));
+}
+
+/*********************************************************/
+__attribute__((target("avx2,fma")))
+static inline __m256d bcast_re(complex a, complex b) {
+  return _mm256_setr_pd(a.real(), a.real(), b.real(), b.real());
+}
+
+/*********************************************************/
+__attribute__((target("avx2,fma")))
+static inline __m256d bcast_im(complex a, complex b) {
+  return _mm256_setr_pd(a.imag(), a.imag(), b.imag(), b.imag());
+}
+
+/*********************************************************/
+__attribute__((target("avx2,fma")))
+static void apply_1_avx2(complex *amps,
+                          size_t stride,
+                   const complex *u,
+                          size_t begin,
+                          size_t end) {
+  double *a = reinterpret_cast<double*>(amps);
+
+  if (stride == 1) {
+    /* each pair fills one register: (a0, a1) -> (u00 a0 + u01 a1, u10 a0 + u11 a1) */
+    __m256d c0r = bcast_re(u[0], u[1]), c0i = bcast_im(u[0], u[1]);
+    __m256d c1r = bcast_re(u[2], u[3]), c1i = bcast_im(u[2], u[3]);
+    for (size_t k = begin; k < end; k++) {
+      __m256d v = _mm256_loadu_pd(a+4*k);
+      __m256d b0 = _mm256_permute2f128_pd(v, v, 0x00);
+      __m256d b1 = _mm256_permute2f128_pd(v, v, 0x11);
+      _mm256_storeu_pd(a+4*k, _mm256_add_pd(cmul(c0r, c0i, b0),
+                                            cmul(c1r, c1i, b1)));
+    }
+    return;
+  }
+
+  size_t head = std::min(end, (begin+1) & ~1ul);
+  apply_1_scalar(amps, stride, u, begin, head);
+  size_t tail = std::max(head, end & ~1ul);
+  apply_1_scalar(amps, stride, u, tail, end);
+
+  __m256d ur[4], ui[4];
+  for (size_t j = 0; j < 4; j++) {
+    ur[j] = _mm256_set1_pd(u[j].real());
+    ui[j] = _mm256_set1_pd(u[j].imag());
+  }
+
+  size_t bit = log2(stride);
+  for (size_t k = head; k < tail; k += 2) {
+    size_t i = insert0(k, bit);
+    double *p0 = a+2*i;
+    double *p1 = a+2*(i+stride);
+    __m256d a0 = _mm256_loadu_pd(p0);
+    __m256d a1 = _mm256_loadu_pd(p1);
+    _mm256_storeu_pd(p0, _mm256_add_pd(cmul(ur[0], ui[0], a0),
+                                       cmul(ur[2], ui[2], a1)));
+    _mm256_storeu_pd(p1, _mm256_add_pd(cmul(ur[1], ui[1], a0),
+                                       cmul(ur[3], ui[3], a1)));
+  }
+}
+
+/*********************************************************/
+__attribute__((target("avx2,fma")))
+static void apply_2_avx2(complex *amps,
+                          size_t stride_hi,
+                          size_t stride_lo,
+                   const complex *u,
+                          size_t begin,
+                          size_t end) {
+  double *a = reinterpret_cast<double*>(amps);
+  size_t bit_hi = log2(stride_hi);
+
+  if (stride_lo == 1) {
+    /* rows 0-1 and rows 2-3 are adjacent: broadcast each input and
+     * accumulate two output registers */
+    __m256d c01r[4], c01i[4], c23r[4], c23i[4];
+    for (size_t c = 0; c < 4; c++) {
+      c01r[c] = bcast_re(u[4*c], u[4*c+1]);
+      c01i[c] = bcast_im(u[4*c], u[4*c+1]);
+      c23r[c] = bcast_re(u[4*c+2], u[4*c+3]);
+      c23i[c] = bcast_im(u[4*c+2], u[4*c+3]);
+    }
+    for (size_t k = begin; k < end; k++) {
+      size_t i = insert0(2*k, bit_hi);
+      double *p01 = a+2*i;
+      double *p23 = a+2*(i+stride_hi);
+      __m256d v01 = _mm256_loadu_pd(p01);
+      __m256d v23 = _mm256_loadu_pd(p23);
+      __m256d b[4] = {_mm256_permute2f128_pd(v01, v01, 0x00),
+                      _mm256_permute2f128_pd(v01, v01, 0x11),
+                      _mm256_permute2f128_pd(v23, v23, 0x00),
+                      _mm256_permute2f128_pd(v23, v23, 0x11)};
+      __m256d o01 = cmul(c01r[0], c01i[0], b[0]);
+      __m256d o23 = cmul(c23r[0], c23i[0], b[0]);
+      for (size_t c = 1; c < 4; c++) {
+        o01 = _mm256_add_pd(o01, cmul(c01r[c], c01i[c], b[c]));
+        o23 = _mm256_add_pd(o23, cmul(c23r[c], c23i[c], b[c]));
+      }
+      _mm256_storeu_pd(p01, o01);
+      _mm256_storeu_pd(p23, o23);
+    }
+    return;
+  }
+
+  size_t head = std::min(end, (begin+1) & ~1ul);
+  apply_2_scalar(amps, stride_hi, stride_lo, u, begin, head);
+  size_t tail = std::max(head, end & ~1ul);
+  apply_2_scalar(amps, stride_hi, stride_lo, u, tail, end);
+
+  __m256d ur[16], ui[16];
+  for (size_t j = 0; j < 16; j++) {
+    ur[j] = _mm256_set1_pd(u[j].real());
+    ui[j] = _mm256_set1_pd(u[j].imag());
+  }
+
+  size_t bit_lo = log2(stride_lo);
+  for (size_t k = head; k < tail; k += 2) {
+    size_t i = insert0(insert0(k, bit_lo), bit_hi);
+    double *p[4] = {a+2*i,
+                    a+2*(i+stride_lo),
+                    a+2*(i+stride_hi),
+                    a+2*(i+stride_hi+stride_lo)};
+    __m256d v[4];
+    for (size_t c = 0; c < 4; c++)
+      v[c] = _mm256_loadu_pd(p[c]);
+    for (size_t r = 0; r < 4; r++) {
+      __m256d o = cmul(ur[r], ui[r], v[0]);
+      for (size_t c = 1; c < 4; c++)
+        o = _mm256_add_pd(o, cmul(ur[r+4*c], ui[r+4*c], v[c]));
+      _mm256_storeu_pd(p[r], o);
+    }
+  }
+}
+
+/*********************************************************/
+__attribute__((target("avx512f")))
+static inline __m512d cmul(__m512d ur, __m512d ui, __m512d x) {
+  return _mm512_fmaddsub_pd(ur, x, _mm512_mul_pd(ui, _mm512_shuffle_pd(x, x, 0x55)));
+}
+
+/*********************************************************/
+__attribute__((target("avx512f")))
+static void apply_1_avx512(complex *amps,
+                            size_t stride,
+                     const complex *u,
+                            size_t begin,
+                            size_t end) {
+  if (stride < 4) {
+    apply_1_avx2(amps, stride, u, begin, end);
+    return;
+  }
+
+  size_t head = std::min(end, (begin+3) & ~3ul);
+  apply_1_avx2(amps, stride, u, begin, head);
+  size_t tail = std::max(head, end & ~3ul);
+  apply_1_avx2(amps, stride, u, tail, end);
+
+  double *a = reinterpret_cast<double*>(amps);
+  __m512d ur[4], ui[4];
+  for (size_t j = 0; j < 4; j++) {
+    ur[j] = _mm512_set1_pd(u[j].real());
+    ui[j] = _mm512_set1_pd(u[j].imag());
+  }
+
+  size_t bit = log2(stride);
+  for (size_t k = head; k < tail; k += 4) {
+    size_t i = insert0(k, bit);
+    double *p0 = a+2*i;
+    double *p1 = a+2*(i+stride);
+    __m512d a0 = _mm512_loadu_pd(p0);
+    __m512d a1 = _mm512_loadu_pd(p1);
+    _mm512_storeu_pd(p0, _mm512_add_pd(cmul(ur[0], ui[0], a0),
+                                       cmul(ur[2], ui[2], a1)));
+    _mm512_storeu_pd(p1, _mm512_add_pd(cmul(ur[1], ui[1], a0),
+                                       cmul(ur[3], ui[3], a1)));
+  }
+}
+
+/*********************************************************/
+__attribute__((target("avx512f")))
+static void apply_2_avx512(complex *amps,
+                            size_t stride_hi,
+                            size_t stride_lo,
+                     const complex *u,
+                            size_t begin,
+                            size_t end) {
+  if (stride_lo < 4) {
+    apply_2_avx2(amps, stride_hi, stride_lo, u, begin, end);
+    return;
+  }
+
+  size_t head = std::min(end, (begin+3) & ~3ul);
+  apply_2_avx2(amps, stride_hi, stride_lo, u, begin, head);
+  size_t tail = std::max(head, end & ~3ul);
+  apply_2_avx2(amps, stride_hi, stride_lo, u, tail, end);
+
+  double *a = reinterpret_cast<double*>(amps);
+  __m512d ur[16], ui[16];
+  for (size_t j = 0; j < 16; j++) {
+    ur[j] = _mm512_set1_pd(u[j].real());
+    ui[j] = _mm512_set1_pd(u[j].imag());
+  }
+
+  size_t bit_hi = log2(stride_hi);
+  size_t bit_lo = log2(stride_lo);
+  for (size_t k = head; k < tail; k += 4) {
+    size_t i = insert0(insert0(k, bit_lo), bit_hi);
+    double *p[4] = {a+2*i,
+                    a+2*(i+stride_lo),
+                    a+2*(i+stride_hi),
+                    a+2*(i+stride_hi+stride_lo)};
+    __m512d v[4];
+    for (size_t c = 0; c < 4; c++)
+      v[c] = _mm512_loadu_pd(p[c]);
+    for (size_t r = 0; r < 4; r++) {
+      __m512d o = cmul(ur[r], ui[r], v[0]);
+      for (size_t c = 1; c < 4; c++)
+        o = _mm512_add_pd(o, cmul(ur[r+4*c], ui[r+4*c], v[c]));
+      _mm512_storeu_pd(p[r], o);
+    }
+  }
+}
+#endif
+
+/*********************************************************/
+struct Kernels {
+  decltype(&apply_1_scalar) apply_1;
+  decltype(&apply_2_scalar) apply_2;
+};
+
+/*********************************************************/
+static Kernels select_kernels() {
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return {apply_1_avx512, apply_2_avx512};
+  if (__builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma"))
+    return {apply_1_avx2, apply_2_avx2};
+#endif
+  return {apply_1_scalar, apply_2_scalar};
+}
+
+static const Kernels kernels = select_kernels();
+
+/*********************************************************/
+void simd::apply_1(complex *amps,
+                    size_t stride,
+             const complex *u,
+                    size_t begin,
+                    size_t end) {
+  kernels.apply_1(amps, stride, u, begin, end);
+}
+
+/*********************************************************/
+void simd::apply_2(complex *amps,
+                    size_t stride_hi,
+                    size_t stride_lo,
+             const complex *u,
+                    size_t begin,
+                    size_t end) {
+  kernels.apply_2(amps, stride_hi, stride_lo, u, begin, end);
+}
@@ -0,0 +1,73 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "test.h"
+
+/* Adding ancillas, using them in a way that leaves them unentangled and
+ * removing them must give back the state of the system, for every layout,
+ * with and without a reserve, adding and removing them all at once or one
+ * by one. */
+
+/*********************************************************/
+int main() {
+  Py_Initialize();
+
+  Gates gates;
+  for (auto [storage, reserve] : {std::pair{"sparse", 0ul}, {"dense", 0ul},
+                                  {"dense", 2ul}, {"auto", 0ul}, 
+                                  {"auto", 2ul}}) {
+    for (std::string state : {"vector", "matrix"}) {
+      QSystem q{3, gates, 1, state, storage, reserve};
+      q.evol("H", 0);
+      q.evol("T", 0);
+      q.cnot(1, {0});
+      q.evol("H", 2);
+      auto before = amplitudes(q);
+
+      std::string name = state+" "+storage+" reserve "
+                       + std::to_string(reserve);
+
+      q.add_ancillas(2);
+      q.cnot(3, {0});
+      q.evol("X", 4);
+      q.cnot(3, {0});
+      q.evol("X", 4);
+      q.rm_ancillas();
+      expect_close(("add and remove "+name).c_str(), amplitudes(q), before);
+
+      q.add_ancillas(1);
+      q.add_ancillas(1);
+      q.evol("H", 4);
+      q.cnot(3, {1});
+      q.cnot(3, {1});
+      q.rm_ancillas(1);
+      q.rm_ancillas(1);
+      expect_close(("one by one "+name).c_str(), amplitudes(q), before);
+    }
+  }
+
+  Py_Finalize();
+  return 0;
+}
@@ -0,0 +1,123 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "test.h"
+
+/* The channels are applied as one local superoperator, on a dense or on a
+ * sparse density matrix. Each one must match the sum of its Kraus terms,
+ * p_k E_k rho E_k^dagger, with the E_k as full matrices. */
+
+struct Op {
+  size_t      size;
+  vec_size_t  row;
+  vec_size_t  col;
+  vec_complex value;
+};
+
+/*********************************************************/
+static Op kron(const Op &a, const Op &b) {
+  size_t dim_b = 1ul << b.size;
+  Op m{a.size+b.size, {}, {}, {}};
+  for (size_t i = 0; i < a.row.size(); i++) {
+    for (size_t j = 0; j < b.row.size(); j++) {
+      m.row.push_back(a.row[i]*dim_b+b.row[j]);
+      m.col.push_back(a.col[i]*dim_b+b.col[j]);
+      m.value.push_back(a.value[i]*b.value[j]);
+    }
+  }
+  return m;
+}
+
+/*********************************************************/
+static std::vector<complex> kraus_sum(const std::vector<complex> &rho,
+                                                           size_t qbit,
+                                           const std::vector<Op> &kraus,
+                                                     vec_float p) {
+  size_t nqbits = log2(rho.size())/2;
+  std::vector<complex> out(rho.size());
+  for (size_t k = 0; k < kraus.size(); k++) {
+    auto u = full_matrix(nqbits, qbit, kraus[k].size, kraus[k].row, 
+                         kraus[k].col, kraus[k].value);
+    auto term = apply_matrix(u, rho);
+    for (size_t i = 0; i < out.size(); i++)
+      out[i] += p[k]*term[i];
+  }
+  return out;
+}
+
+/*********************************************************/
+int main() {
+  Py_Initialize();
+
+  double s = 1/std::sqrt(2);
+  complex i{0, 1};
+  Op I{1, {0, 1}, {0, 1}, {1, 1}};
+  Op X{1, {1, 0}, {0, 1}, {1, 1}};
+  Op Y{1, {1, 0}, {0, 1}, {i, -i}};
+  Op Z{1, {0, 1}, {0, 1}, {1, -1}};
+  Op H{1, {0, 1, 0, 1}, {0, 0, 1, 1}, {s, s, s, -s}};
+
+  double p = 0.3;
+  Op E0{1, {0, 1}, {0, 1}, {1, sqrt(1-p)}};
+  Op E1{1, {0}, {1}, {sqrt(p)}};
+
+  Gates gates;
+  gates.make_channel("noise", {"XZ", "II", "YH"}, {0.2, 0.5, 0.3});
+
+  for (std::string storage : {"sparse", "dense"}) {
+    QSystem q{4, gates, 1, "matrix", storage};
+    q.evol("H", 0);
+    q.cnot(1, {0});
+    q.evol("H", 2);
+    q.evol("T", 2);
+    q.evol("X", 3);
+    auto rho = amplitudes(q);
+
+    q.flip('Y', 3, 0.1);
+    rho = kraus_sum(rho, 3, {I, Y}, {0.9, 0.1});
+    expect_close(("flip "+storage).c_str(), amplitudes(q), rho);
+
+    q.amp_damping(1, p);
+    rho = kraus_sum(rho, 1, {E0, E1}, {1, 1});
+    expect_close(("amp_damping "+storage).c_str(), amplitudes(q), rho);
+
+    q.dpl_channel(0, 0.2);
+    rho = kraus_sum(rho, 0, {I, X, Y, Z}, {0.8, 0.2/3, 0.2/3, 0.2/3});
+    expect_close(("dpl_channel "+storage).c_str(), amplitudes(q), rho);
+
+    q.sum(2, {"XZ", "II", "YH"}, {0.2, 0.5, 0.3});
+    rho = kraus_sum(rho, 2, {kron(X, Z), kron(I, I), kron(Y, H)},
+                    {0.2, 0.5, 0.3});
+    expect_close(("sum "+storage).c_str(), amplitudes(q), rho);
+
+    q.channel("noise", 1);
+    rho = kraus_sum(rho, 1, {kron(X, Z), kron(I, I), kron(Y, H)},
+                    {0.2, 0.5, 0.3});
+    expect_close(("channel "+storage).c_str(), amplitudes(q), rho);
+  }
+
+  Py_Finalize();
+  return 0;
+}
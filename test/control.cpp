@@ -0,0 +1,74 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "test.h"
+
+/* A gate that is the identity outside the subspace where some of its qubits
+ * are 1 is applied just on that subspace. A projector looks like one in its
+ * non-zero elements, but its columns outside that subspace are zero, so it
+ * must be applied on every amplitude. */
+
+/*********************************************************/
+int main() {
+  Py_Initialize();
+
+  struct Case {
+    std::string name;
+    vec_size_t  row;
+    vec_size_t  col;
+    vec_complex value;
+  };
+  double s = 1/std::sqrt(2);
+  std::vector<Case> cases{{"CX", {0, 1, 3, 2}, {0, 1, 2, 3}, {1, 1, 1, 1}},
+                          {"CH", {0, 1, 2, 3, 2, 3}, {0, 1, 2, 2, 3, 3},
+                                 {1, 1, s, s, s, -s}},
+                          {"P1+", {2, 3, 2, 3}, {2, 2, 3, 3}, 
+                                  {0.5, 0.5, 0.5, 0.5}},
+                          {"P1K", {2, 3}, {3, 3}, {s, s}}};
+
+  Gates gates;
+  for (auto &gate : cases)
+    gates.make_mgate(gate.name, 2, gate.row, gate.col, gate.value);
+
+  for (std::string storage : {"sparse", "dense"}) {
+    for (std::string state : {"vector", "matrix"}) {
+      for (auto &gate : cases) {
+        QSystem q{3, gates, 1, state, storage};
+        for (size_t i = 0; i < 3; i++) 
+          q.evol("H", i);
+        q.evol("T", 2);
+        auto before = amplitudes(q);
+
+        q.evol(gate.name, 1);
+        auto u = full_matrix(3, 1, 2, gate.row, gate.col, gate.value);
+        expect_close((gate.name+" "+state+" "+storage).c_str(),
+                     amplitudes(q), apply_matrix(u, before));
+      }
+    }
+  }
+
+  Py_Finalize();
+  return 0;
+}
@@ -0,0 +1,108 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "test.h"
+
+/* The expectation value of a sum of Pauli strings, computed in a single
+ * pass per group of terms, against <psi|H|psi> or Tr(rho H) with H built
+ * as a full matrix. */
+
+/*********************************************************/
+static std::vector<complex> pauli_sum(size_t nqbits,
+                                     vec_str terms,
+                                   vec_float coeffs) {
+  size_t dim = 1ul << nqbits;
+  std::vector<complex> h(dim*dim);
+  for (size_t t = 0; t < terms.size(); t++) {
+    for (size_t col = 0; col < dim; col++) {
+      size_t row = col;
+      complex value = coeffs[t];
+      for (size_t q = 0; q < terms[t].size(); q++) {
+        size_t bit = 1ul << (nqbits-q-1);
+        bool one = col & bit;
+        switch (terms[t][q]) {
+        case 'X':
+          row ^= bit;
+          break;
+        case 'Y':
+          row ^= bit;
+          value *= one? complex{0, -1} : complex{0, 1};
+          break;
+        case 'Z':
+          value *= one? -1 : 1;
+          break;
+        }
+      }
+      h[col*dim+row] += value;
+    }
+  }
+  return h;
+}
+
+/*********************************************************/
+int main() {
+  Py_Initialize();
+
+  size_t nqbits = 4;
+  size_t dim = 1ul << nqbits;
+  vec_str terms{"ZZ", "XIX", "YYZ", "IXYI", "ZIIY", "XXXX", "IIZ", "IZIY"};
+  vec_float coeffs{0.5, -1.25, 0.75, 2, -0.5, 0.3, 1, 0.9};
+  auto h = pauli_sum(nqbits, terms, coeffs);
+
+  Gates gates;
+  for (std::string storage : {"sparse", "dense"}) {
+    for (std::string state : {"vector", "matrix"}) {
+      QSystem q{nqbits, gates, 1, state, storage};
+      q.evol("H", 0);
+      q.evol("T", 0);
+      q.cnot(2, {0});
+      q.evol("H", 3);
+      q.evol("S", 3);
+      q.evol("Y", 1);
+      if (state == "matrix")
+        q.dpl_channel(2, 0.3);
+
+      auto amps = amplitudes(q);
+      complex expected = 0;
+      if (state == "vector") {
+        for (size_t c = 0; c < dim; c++)
+          for (size_t r = 0; r < dim; r++)
+            expected += std::conj(amps[r])*h[c*dim+r]*amps[c];
+      } else {
+        for (size_t c = 0; c < dim; c++)
+          for (size_t r = 0; r < dim; r++)
+            expected += amps[c*dim+r]*h[r*dim+c];
+      }
+
+      expect_close(("expectation "+state+" "+storage).c_str(),
+                   {q.expectation(terms, coeffs)}, {expected});
+      expect_close(("state kept "+state+" "+storage).c_str(),
+                   amplitudes(q), amps);
+    }
+  }
+
+  Py_Finalize();
+  return 0;
+}
@@ -0,0 +1,83 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "test.h"
+
+/* The gates applied on busy qubits are fused into the pending operators,
+ * unless one of them has a faster kernel. Applying the same circuit with a
+ * sync after each gate must give the same state. */
+
+/*********************************************************/
+template <class F>
+static void circuit(QSystem &q, F step) {
+  for (size_t i = 0; i < 4; i++) {
+    q.evol("H", i);
+    step();
+  }
+  q.evol("T", 1);             step();
+  q.evol("Y", 1);             step();
+  q.evol("RR", 1);            step();
+  q.evol("S", 2, 2);          step();
+  q.evol("X", 0);             step();
+  q.evol("H", 0);             step();
+  q.cnot(2, {0});             step();
+  q.evol("H", 2);             step();
+  q.evol("RR", 0, 2, true);   step();
+  q.swap(0, 3);               step();
+  q.evol("Y", 3);             step();
+  q.controlled("RR", 1, {0}); step();
+  q.evol("H", 2);             step();
+  q.qft(0, 3);                step();
+  q.evol("T", 1, 1, true);    step();
+  q.evol("RR", {3, 1});       step();
+  q.evol("H", 3);             step();
+}
+
+/*********************************************************/
+int main() {
+  Py_Initialize();
+
+  Gates gates;
+  double s = 1/std::sqrt(2);
+  gates.make_mgate("RR", 2, {0, 1, 0, 1, 2, 3, 2, 3}, {0, 0, 1, 1, 2, 2, 3, 3},
+                   {s, complex{0, s}, complex{0, s}, s,
+                    complex{0, s}, s, s, complex{0, s}});
+
+  for (std::string storage : {"sparse", "dense", "auto"}) {
+    for (std::string state : {"vector", "matrix"}) {
+      QSystem fused{4, gates, 1, state, storage};
+      circuit(fused, []() {});
+
+      QSystem unfused{4, gates, 1, state, storage};
+      circuit(unfused, [&]() { amplitudes(unfused); });
+
+      expect_close(("fused "+state+" "+storage).c_str(),
+                   amplitudes(fused), amplitudes(unfused));
+    }
+  }
+
+  Py_Finalize();
+  return 0;
+}
@@ -0,0 +1,74 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "test.h"
+
+/* A dense state gets the QFT through the butterfly network and a sparse
+ * one through the operator of make_qft. Both must match the QFT matrix,
+ * w^(i*j)/sqrt(N), and its inverse. */
+
+/*********************************************************/
+int main() {
+  Py_Initialize();
+
+  size_t nqbits = 5, qbegin = 1, qend = 4;
+  size_t size_n = qend-qbegin;
+  size_t dim_n = 1ul << size_n;
+  double pi = acos(-1);
+
+  Gates gates;
+  for (bool inver : {false, true}) {
+    vec_size_t row, col;
+    vec_complex value;
+    for (size_t i = 0; i < dim_n; i++) {
+      for (size_t j = 0; j < dim_n; j++) {
+        row.push_back(i);
+        col.push_back(j);
+        double angle = 2*pi*(i*j % dim_n)/dim_n;
+        value.push_back(std::polar(1/sqrt(dim_n), inver? -angle : angle));
+      }
+    }
+    auto u = full_matrix(nqbits, qbegin, size_n, row, col, value);
+
+    for (std::string storage : {"sparse", "dense"}) {
+      for (std::string state : {"vector", "matrix"}) {
+        QSystem q{nqbits, gates, 1, state, storage};
+        q.evol("H", 0);
+        q.evol("X", 2);
+        q.cnot(3, {0});
+        q.evol("T", 3);
+        auto before = amplitudes(q);
+
+        q.qft(qbegin, qend, inver);
+        expect_close(((inver? "inverse qft " : "qft ")+state+" "
+                      +storage).c_str(),
+                     amplitudes(q), apply_matrix(u, before));
+      }
+    }
+  }
+
+  Py_Finalize();
+  return 0;
+}
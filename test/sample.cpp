@@ -0,0 +1,90 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "test.h"
+
+/* Each QSystem draws from its own Philox generator, so the samples and
+ * measurements depend only on the seed: not on other systems drawing in
+ * between, nor on the number of threads that sample. */
+
+/*********************************************************/
+static void prepare(QSystem &q) {
+  q.evol("H", 0, 5);
+  q.evol("T", 1);
+  q.cnot(4, {1});
+  q.evol("H", 1);
+}
+
+/*********************************************************/
+static bool same(PyObject *a, PyObject *b) {
+  bool equal = PyObject_RichCompareBool(a, b, Py_EQ) == 1;
+  Py_DECREF(a);
+  Py_DECREF(b);
+  return equal;
+}
+
+/*********************************************************/
+int main() {
+  Py_Initialize();
+
+  Gates gates;
+  vec_size_t qbits{0, 1, 4};
+  size_t shots = 10000;
+
+  for (std::string storage : {"sparse", "dense"}) {
+    QSystem a{5, gates, 7, "vector", storage};
+    QSystem b{5, gates, 7, "vector", storage};
+    QSystem other{5, gates, 7, "vector", storage};
+    prepare(a);
+    prepare(b);
+    prepare(other);
+
+    expect(("same seed "+storage).c_str(), 
+           same(a.sample(qbits, shots), b.sample(qbits, shots)));
+
+    Py_DECREF(other.sample(qbits, shots));
+    other.measure_all();
+    expect(("other system drawing "+storage).c_str(),
+           same(a.sample(qbits, shots), b.sample(qbits, shots)));
+
+    b.set_threads(4);
+    expect(("threads "+storage).c_str(),
+           same(a.sample(qbits, shots), b.sample(qbits, shots)));
+
+    a.measure_all();
+    b.measure_all();
+    expect(("measure "+storage).c_str(), a.bits() == b.bits());
+  }
+
+  QSystem a{5, gates, 7};
+  QSystem c{5, gates, 8};
+  prepare(a);
+  prepare(c);
+  expect("other seed", 
+         not same(a.sample(qbits, shots), c.sample(qbits, shots)));
+
+  Py_Finalize();
+  return 0;
+}
@@ -0,0 +1,97 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#include "test.h"
+#include "../header/simd.h"
+#include <random>
+
+/* The one and two qubit kernels that the CPU selects, AVX-512, AVX2 or
+ * scalar, against the matrix product written out, for every stride and
+ * for ranges that do not start or end on a vector boundary. */
+
+/*********************************************************/
+int main() {
+  std::mt19937_64 rng{42};
+  std::normal_distribution<double> normal;
+  auto random = [&](size_t size) {
+    std::vector<complex> v(size);
+    for (auto &i : v)
+      i = complex{normal(rng), normal(rng)};
+    return v;
+  };
+
+  size_t nqbits = 7;
+  size_t dim = 1ul << nqbits;
+  std::vector<complex> u = random(16);
+
+  for (size_t q = 0; q < nqbits; q++) {
+    size_t stride = 1ul << q;
+    for (auto [begin, end] : {std::pair{0ul, dim/2}, {3ul, dim/2-5}}) {
+      auto amps = random(dim);
+      auto ref = amps;
+      simd::apply_1(amps.data(), stride, u.data(), begin, end);
+
+      for (size_t k = begin; k < end; k++) {
+        size_t i = (k/stride)*2*stride+k%stride;
+        complex a0 = ref[i], a1 = ref[i+stride];
+        ref[i] = u[0]*a0+u[2]*a1;
+        ref[i+stride] = u[1]*a0+u[3]*a1;
+      }
+      expect_close(("apply_1 stride "+std::to_string(stride)+" from "
+                    +std::to_string(begin)).c_str(), amps, ref);
+    }
+  }
+
+  for (size_t lo = 0; lo < nqbits; lo++) {
+    for (size_t hi = lo+1; hi < nqbits; hi++) {
+      size_t stride_lo = 1ul << lo, stride_hi = 1ul << hi;
+      for (auto [begin, end] : {std::pair{0ul, dim/4}, {1ul, dim/4-3}}) {
+        auto amps = random(dim);
+        auto ref = amps;
+        simd::apply_2(amps.data(), stride_hi, stride_lo, u.data(), begin, end);
+
+        /* the k-th quad has the bits hi and lo of its first index at 0 */
+        std::vector<size_t> first;
+        for (size_t i = 0; i < dim; i++)
+          if (not (i & stride_hi) and not (i & stride_lo))
+            first.push_back(i);
+        for (size_t k = begin; k < end; k++) {
+          size_t i = first[k];
+          size_t index[4] = {i, i+stride_lo, i+stride_hi, i+stride_hi+stride_lo};
+          complex a[4];
+          for (size_t c = 0; c < 4; c++)
+            a[c] = ref[index[c]];
+          for (size_t r = 0; r < 4; r++)
+            ref[index[r]] = u[r]*a[0]+u[r+4]*a[1]+u[r+8]*a[2]+u[r+12]*a[3];
+        }
+        expect_close(("apply_2 strides "+std::to_string(stride_hi)+" "
+                      +std::to_string(stride_lo)+" from "
+                      +std::to_string(begin)).c_str(), amps, ref);
+      }
+    }
+  }
+
+  return 0;
+}
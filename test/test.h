@@ -0,0 +1,123 @@
+/* MIT License
+ * 
+ * Copyright (c) 2019 Evandro Chagas Ribeiro da Rosa <ev.crr97@gmail.com>
+ * Copyright (c) 2019 Bruno Gouvêa Taketani <b.taketani@ufsc.br>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */                                                                               
+
+
+#pragma once
+#include "../header/qsystem.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+/* Each test computes the same state in two ways, for example with a fast
+ * kernel and with the operator it replaces, and fails if they differ. */
+
+//! Dense column-major copy of the state of a QSystem
+inline std::vector<complex> amplitudes(QSystem &q) {
+  PyObject* qbits = q.get_qbits();
+  PyObject* csc = PyTuple_GetItem(qbits, 0);
+  PyObject* shape = PyTuple_GetItem(qbits, 1);
+  size_t n_rows = PyLong_AsSize_t(PyTuple_GetItem(shape, 0));
+  size_t n_cols = PyLong_AsSize_t(PyTuple_GetItem(shape, 1));
+  PyObject* values = PyTuple_GetItem(csc, 0);
+  PyObject* rows = PyTuple_GetItem(csc, 1);
+  PyObject* col_ptrs = PyTuple_GetItem(csc, 2);
+
+  std::vector<complex> amps(n_rows*n_cols);
+  for (size_t col = 0; col < n_cols; col++) {
+    size_t begin = PyLong_AsSize_t(PyList_GetItem(col_ptrs, col));
+    size_t end = PyLong_AsSize_t(PyList_GetItem(col_ptrs, col+1));
+    for (size_t k = begin; k < end; k++) {
+      PyObject* value = PyList_GetItem(values, k);
+      size_t row = PyLong_AsSize_t(PyList_GetItem(rows, k));
+      amps[col*n_rows+row] = complex{PyComplex_RealAsDouble(value),
+                                     PyComplex_ImagAsDouble(value)};
+    }
+  }
+
+  Py_DECREF(qbits);
+  return amps;
+}
+
+//! Column-major matrix of a gate on the qubits [qbit, qbit+size) of a system
+inline std::vector<complex> full_matrix(size_t nqbits,
+                                         size_t qbit,
+                                         size_t size,
+                                     vec_size_t row,
+                                     vec_size_t col,
+                                    vec_complex value) {
+  size_t dim = 1ul << nqbits;
+  size_t shift = nqbits-qbit-size;
+  size_t mask = ((1ul << size)-1) << shift;
+  std::vector<complex> u(dim*dim);
+  for (size_t i = 0; i < row.size(); i++)
+    for (size_t rest = 0; rest < dim; rest++)
+      if (not (rest & mask))
+        u[(rest | col[i] << shift)*dim+(rest | row[i] << shift)] = value[i];
+  return u;
+}
+
+//! Apply a full matrix to a state, as U|psi> or U rho U^dagger
+inline std::vector<complex> apply_matrix(const std::vector<complex> &u,
+                                         const std::vector<complex> &amps) {
+  size_t dim = std::sqrt(u.size());
+  size_t n_cols = amps.size()/dim;
+  std::vector<complex> tmp(amps.size());
+  for (size_t c = 0; c < n_cols; c++)
+    for (size_t k = 0; k < dim; k++)
+      for (size_t r = 0; r < dim; r++)
+        tmp[c*dim+r] += u[k*dim+r]*amps[c*dim+k];
+  if (n_cols == 1) 
+    return tmp;
+
+  std::vector<complex> out(amps.size());
+  for (size_t c = 0; c < dim; c++)
+    for (size_t k = 0; k < dim; k++)
+      for (size_t r = 0; r < dim; r++)
+        out[c*dim+r] += tmp[k*dim+r]*std::conj(u[k*dim+c]);
+  return out;
+}
+
+//! Exit with an error if `ok` is false
+inline void expect(const char *what, bool ok) {
+  if (not ok) {
+    fprintf(stderr, "FAIL %s\n", what);
+    exit(EXIT_FAILURE);
+  }
+  printf("ok %s\n", what);
+}
+
+//! Exit with an error if two states differ by more than `tol`
+inline void expect_close(const char *what,
+          const std::vector<complex> &a,
+          const std::vector<complex> &b,
+                               double tol=1e-12) {
+  double diff = a.size() == b.size()? 0 : INFINITY;
+  for (size_t i = 0; i < a.size() and i < b.size(); i++)
+    diff = std::max(diff, std::abs(a[i]-b[i]));
+  if (diff > tol) {
+    fprintf(stderr, "FAIL %s: difference %g\n", what, diff);
+    exit(EXIT_FAILURE);
+  }
+  printf("ok %s\n", what);
+}